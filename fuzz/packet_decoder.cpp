@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../include/rconpp/packet_decoder.h"
+
+/*
+ * Feeds arbitrary bytes to a packet_decoder, split into reads the way a socket might split them.
+ * The first byte picks the read size, everything after it is the stream.
+ *
+ * The same stream is also decoded in one go, and both must see the same packets, however the reads were split.
+ */
+
+namespace {
+
+constexpr int32_t FUZZ_MAX_PACKET_SIZE = rconpp::MAX_PACKET_SIZE;
+
+struct seen_packet {
+	int32_t id{0};
+	int32_t type{0};
+	std::string body{};
+
+	bool operator==(const seen_packet& other) const {
+		return id == other.id && type == other.type && body == other.body;
+	}
+};
+
+/**
+ * @brief Takes every packet the decoder has. Aborts if a packet breaks the limit it was decoded with.
+ */
+rconpp::decode_result drain(rconpp::packet_decoder& decoder, std::vector<seen_packet>& seen) {
+	rconpp::decoded_packet packet{};
+	rconpp::decode_result result{rconpp::DECODE_NEED_MORE};
+
+	while ((result = decoder.next(packet, FUZZ_MAX_PACKET_SIZE)) == rconpp::DECODE_PACKET) {
+		if (packet.body.size() > static_cast<size_t>(FUZZ_MAX_PACKET_SIZE - rconpp::MIN_PACKET_SIZE)) {
+			std::abort();
+		}
+
+		seen.push_back({ packet.id, packet.type, std::string(packet.body) });
+	}
+
+	return result;
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+	if (size == 0) {
+		return 0;
+	}
+
+	const size_t read_size = static_cast<size_t>(data[0]) + 1;
+	const char* stream = reinterpret_cast<const char*>(data + 1);
+	const size_t stream_size = size - 1;
+
+	rconpp::packet_decoder split{};
+	std::vector<seen_packet> split_seen{};
+	rconpp::decode_result split_result{rconpp::DECODE_NEED_MORE};
+
+	for (size_t offset = 0; offset < stream_size && split_result != rconpp::DECODE_INVALID; offset += read_size) {
+		const size_t chunk = std::min(read_size, stream_size - offset);
+
+		std::memcpy(split.prepare(chunk), stream + offset, chunk);
+		split.commit(chunk);
+
+		split_result = drain(split, split_seen);
+
+		// Between reads, the decoder should never be holding more than one partial packet.
+		if (split_result == rconpp::DECODE_NEED_MORE && split.buffered() > static_cast<size_t>(FUZZ_MAX_PACKET_SIZE + rconpp::PACKET_SIZE_BYTES)) {
+			std::abort();
+		}
+	}
+
+	rconpp::packet_decoder whole{};
+	std::vector<seen_packet> whole_seen{};
+
+	whole.feed(stream, stream_size);
+	const rconpp::decode_result whole_result = drain(whole, whole_seen);
+
+	if (split_result != whole_result || split_seen != whole_seen) {
+		std::abort();
+	}
+
+	return 0;
+}
+
+#ifdef RCONPP_FUZZ_STANDALONE
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+/*
+ * Without libFuzzer, this replays the files it is given (a corpus, or crashes found elsewhere) through the target.
+ */
+int main(int argc, char* argv[]) {
+	for (int i = 1; i < argc; i++) {
+		std::ifstream file(argv[i], std::ios::binary);
+
+		if (!file) {
+			std::cerr << "Could not open " << argv[i] << "\n";
+			return 1;
+		}
+
+		const std::vector<char> input((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(input.data()), input.size());
+	}
+
+	std::cout << "Ran " << (argc - 1) << " input(s)." << "\n";
+
+	return 0;
+}
+#endif
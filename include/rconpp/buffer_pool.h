@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "export.h"
+#include "utilities.h"
+
+namespace rconpp {
+
+/**
+ * @brief How well a `buffer_pool` is doing.
+ */
+struct buffer_pool_stats {
+	/**
+	 * @brief Buffers handed out that were already allocated.
+	 */
+	uint64_t hits{0};
+
+	/**
+	 * @brief Buffers handed out that had to be allocated, as the pool was empty.
+	 */
+	uint64_t misses{0};
+
+	/**
+	 * @brief Buffers given back and kept for next time.
+	 */
+	uint64_t returned{0};
+
+	/**
+	 * @brief Buffers given back but freed, as the pool was full or they had grown too big to be worth keeping.
+	 */
+	uint64_t discarded{0};
+
+	/**
+	 * @brief Buffers waiting in the pool right now.
+	 */
+	size_t pooled{0};
+
+	/**
+	 * @returns How many buffers handed out were already allocated, from 0 to 1 (0 if none have been handed out).
+	 */
+	double hit_rate() const {
+		const uint64_t total = hits + misses;
+		return total == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(total);
+	}
+};
+
+/**
+ * @brief Keeps the read and write buffers of closed connections, so new connections can use them instead of allocating their own.
+ *
+ * Every buffer starts out as a slab of `slab_size` bytes, enough for a full socket read (`READ_CHUNK_SIZE`) on top of a partial packet.
+ * Connections hold on to their buffers for as long as they're open, so the pool is only touched when a connection opens or closes.
+ *
+ * @note This is safe to use from any thread.
+ */
+class RCONPP_EXPORT buffer_pool {
+	std::vector<std::vector<char>> free_buffers{};
+	mutable std::mutex free_mutex;
+
+	const size_t slab_size{0};
+	const size_t max_pooled{0};
+
+	std::atomic<uint64_t> hits{0};
+	std::atomic<uint64_t> misses{0};
+	std::atomic<uint64_t> returned{0};
+	std::atomic<uint64_t> discarded{0};
+
+public:
+	/**
+	 * @brief buffer_pool constructor.
+	 *
+	 * @param _slab_size How many bytes each buffer has room for when it's handed out.
+	 * @param _max_pooled How many buffers to keep at most. Any more given back are freed.
+	 */
+	explicit buffer_pool(size_t _slab_size = BUFFER_SLAB_SIZE, size_t _max_pooled = 64);
+
+	buffer_pool(const buffer_pool&) = delete;
+	buffer_pool& operator=(const buffer_pool&) = delete;
+
+	/**
+	 * @brief Get an empty buffer with room for at least `slab_size` bytes.
+	 */
+	std::vector<char> acquire();
+
+	/**
+	 * @brief Give a buffer back to the pool. Buffers smaller than a slab (like ones never taken from a pool) are just freed.
+	 */
+	void release(std::vector<char>&& buffer);
+
+	/**
+	 * @returns The pool's counters.
+	 */
+	buffer_pool_stats stats() const;
+
+	/**
+	 * @returns How many bytes each buffer has room for when it's handed out.
+	 */
+	size_t slab() const {
+		return slab_size;
+	}
+};
+
+} // namespace rconpp
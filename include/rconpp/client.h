@@ -18,33 +18,327 @@
 #include <cstring>
 #include <atomic>
 #include <thread>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
 #include <condition_variable>
+#include <future>
+#ifdef RCONPP_CORO
+#include <coroutine>
+#endif
+#include "buffer_pool.h"
+#include "io_context.h"
+#include "log.h"
+#include "metrics.h"
+#include "mpsc_queue.h"
+#include "packet_decoder.h"
 #include "utilities.h"
 
 namespace rconpp {
 
+enum multi_packet_mode {
+	/**
+	 * @brief The first packet with a matching ID is the whole response.
+	 */
+	MULTI_PACKET_NONE = 0,
+
+	/**
+	 * @brief After each command, send an empty `SERVERDATA_RESPONSE_VALUE` packet with a different ID.
+	 * The server mirrors it back once every packet of the response has been sent, so that packet marks the end of the response.
+	 *
+	 * @note This is how Source servers (and rcon++ servers) should be talked to.
+	 */
+	MULTI_PACKET_TERMINATOR = 1,
+
+	/**
+	 * @brief Keep reading while packets are full (their body is `full_packet_body_size` bytes). The first packet that isn't full ends the response.
+	 *
+	 * @note Use this for servers that don't like empty `SERVERDATA_RESPONSE_VALUE` packets, like Minecraft.
+	 * A response that is exactly a multiple of `full_packet_body_size` will only end when the read times out.
+	 */
+	MULTI_PACKET_SIZE = 2,
+};
+
 struct queued_request {
 	std::string data{};
 	int32_t id{0};
 	data_type type{data_type::SERVERDATA_AUTH};
 	std::function<void(const response& response)> callback;
+
+	/**
+	 * @brief When to give up waiting on the response, on the steady clock. Left empty, the client's `request_timeout` is used.
+	 */
+	std::chrono::steady_clock::time_point deadline{};
+};
+
+class rcon_client;
+
+#ifdef RCONPP_CORO
+/**
+ * @brief What `rcon_client::execute` returns. `co_await` it to suspend until the response arrives.
+ *
+ * The awaiter holds the response itself and the request's callback only points back at it, so there's no shared state or promise behind it.
+ * The request is still queued like any other from `send_data`, so it costs the same (a copy of the command, and its place in the queue and in the pending requests).
+ * The coroutine resumes on the thread reading responses, so hand anything slow off to another thread.
+ */
+class command_awaitable {
+	rcon_client& client;
+	std::string_view command;
+	data_type type;
+	int32_t id;
+
+	response result{};
+
+public:
+	command_awaitable(rcon_client& _client, std::string_view _command, data_type _type, int32_t _id) : client(_client), command(_command), type(_type), id(_id) {}
+
+	/**
+	 * @brief We don't suspend when we're not connected, there will never be a response.
+	 */
+	bool await_ready() const noexcept;
+
+	void await_suspend(std::coroutine_handle<> handle);
+
+	response await_resume() noexcept {
+		return std::move(result);
+	}
+};
+#endif
+
+/**
+ * @brief What an `rcon_client` has done since it was created, from `rcon_client::metrics`.
+ */
+struct RCONPP_EXPORT client_metrics {
+	uint64_t requests_sent{0};
+
+	/**
+	 * @brief Requests the server answered (even if only part of the answer arrived before the request timed out).
+	 */
+	uint64_t responses_received{0};
+
+	/**
+	 * @brief Requests that were never sent, or were never answered.
+	 */
+	uint64_t requests_failed{0};
+
+	uint64_t packets_in{0};
+	uint64_t packets_out{0};
+	uint64_t bytes_in{0};
+	uint64_t bytes_out{0};
+
+	/**
+	 * @brief How long each answered request took, from being sent to its response being finished.
+	 */
+	histogram_snapshot request_time{};
+
+	/**
+	 * @returns Everything above in the Prometheus text format, with names starting `rconpp_client_`.
+	 */
+	std::string to_text() const;
 };
 
 class RCONPP_EXPORT rcon_client {
+	friend class rcon_io_context;
+
 	const std::string address{};
 	const int port{0};
 	const std::string password{};
 	SOCKET_TYPE sock{INVALID_SOCKET};
 
-	std::vector<queued_request> requests_queued{};
+	/**
+	 * @brief Requests waiting for `queue_runner` to send them. Any thread can add to this without taking a lock.
+	 */
+	mpsc_queue<queued_request> requests_queued{};
 
 	std::thread queue_runner;
 
+	/**
+	 * @brief Reads every packet the server sends once we're connected, and hands them to whichever request they answer.
+	 */
+	std::thread response_reader;
+
+	/**
+	 * @brief A request that has been sent and is waiting on its response.
+	 */
+	struct pending_request {
+		std::function<void(const response& response)> callback;
+
+		/**
+		 * @brief The response so far. Packets are read straight onto the end of this.
+		 */
+		std::string data{};
+
+		/**
+		 * @brief The ID of the empty packet sent after the request, which marks the end of the response (0 if one wasn't sent).
+		 */
+		int32_t terminator_id{0};
+
+		bool received_part{false};
+
+		/**
+		 * @brief When the request fails if it hasn't been answered, on the steady clock.
+		 */
+		std::chrono::steady_clock::time_point deadline{};
+
+		std::chrono::steady_clock::time_point last_received_at{};
+
+		/**
+		 * @brief When the request was sent, for `request_time`.
+		 */
+		std::chrono::steady_clock::time_point sent_at{};
+	};
+
+	/**
+	 * @brief Every request waiting on a response, by ID.
+	 */
+	std::unordered_map<int32_t, pending_request> pending_requests{};
+
+	/**
+	 * @brief Terminator IDs, mapped to the ID of the request they end.
+	 */
+	std::unordered_map<int32_t, int32_t> pending_terminators{};
+
+	std::mutex pending_mutex;
+
+	/**
+	 * @brief Bytes received from the server, turned back into packets. Used while logging in, then by whichever of `response_reader` or `attached_loop` reads responses.
+	 */
+	packet_decoder decoder{};
+
+	/**
+	 * @brief Where packets are encoded before being sent by `queue_runner` (or during login). Kept between sends, so it stops allocating once it's big enough.
+	 */
+	std::vector<char> send_buffer{};
+
+	/**
+	 * @brief Where response packets are put back together during login. This is kept between responses, so it only grows when a bigger response comes in.
+	 */
+	std::string assembly_buffer{};
+
+	/**
+	 * @brief The next ID to use for packets rcon++ sends on its own (like multi-packet terminators).
+	 * These start far above the IDs people usually pick, to avoid mixing them up.
+	 */
+	std::atomic<int32_t> next_internal_id{INTERNAL_ID_START};
+
+	/**
+	 * @brief Requests that have been queued but not finished yet (either waiting to be sent, or waiting on a response).
+	 */
+	std::atomic<size_t> requests_in_flight{0};
+
+	/**
+	 * @brief The loop watching our socket, if we've been attached to an `rcon_io_context`. Otherwise, we have threads of our own.
+	 */
+	rcon_io_context::io_loop* attached_loop{nullptr};
+
+	/**
+	 * @brief Is there a drain waiting to run on `attached_loop`? Stops every `send_data` call posting its own.
+	 */
+	std::atomic<bool> drain_scheduled{false};
+
+	/**
+	 * @brief Is our socket on `attached_loop`? Only touched on the loop's thread, like everything below it.
+	 */
+	bool registered{false};
+
+	/**
+	 * @brief Have we been taken off `attached_loop` for good (we've disconnected, or are shutting down)?
+	 */
+	bool detached{false};
+
+	std::vector<queued_request> drain_batch{};
+
+	/**
+	 * @brief Bytes waiting for room in the socket, and how many of them have been sent already.
+	 */
+	std::vector<char> write_buffer{};
+	size_t write_offset{0};
+
+	/**
+	 * @brief Everything `metrics` reports. Updated from any thread without a lock.
+	 */
+	struct metric_set {
+		metric_counter requests_sent{};
+		metric_counter responses_received{};
+		metric_counter requests_failed{};
+		metric_counter packets_in{};
+		metric_counter packets_out{};
+		metric_counter bytes_in{};
+		metric_counter bytes_out{};
+
+		latency_histogram request_time{};
+	};
+
+	metric_set counters{};
+
 public:
 	std::atomic<bool> connected{false};
 
+	/**
+	 * @brief How responses that are split over multiple packets should be detected. See `multi_packet_mode`.
+	 */
+	multi_packet_mode multi_packet{MULTI_PACKET_TERMINATOR};
+
+	/**
+	 * @brief The body size of a full packet, used by `MULTI_PACKET_SIZE`. Minecraft servers use 4096.
+	 */
+	size_t full_packet_body_size{MAX_PACKET_SIZE - MIN_PACKET_SIZE};
+
+	/**
+	 * @brief How many bytes to set aside for responses up front. Raising this to fit your biggest response
+	 * means receiving it only needs the one allocation (for the response itself).
+	 */
+	size_t response_reserve{MAX_PACKET_SIZE * 4};
+
+	/**
+	 * @brief How long `start` waits on the server to accept the connection, before giving up.
+	 */
+	std::chrono::milliseconds connect_timeout{DEFAULT_TIMEOUT * 1000};
+
+	/**
+	 * @brief How long a request (including logging in) waits on its response before it fails, unless it was given a deadline of its own.
+	 */
+	std::chrono::milliseconds request_timeout{REQUEST_TIMEOUT * 1000};
+
+	/**
+	 * @brief The biggest packet size the server can send us. Anything bigger means the stream is broken, and we disconnect.
+	 */
+	int max_packet_size{MAX_PACKET_SIZE * 4};
+
+	/**
+	 * @brief Where the client gets its read and write buffers from, and gives them back to once it's destroyed. Left empty, the client allocates its own.
+	 * `rcon_client_pool` and `rcon_io_context` give every client they look after the same pool, so replacement clients reuse the buffers of the clients they replace.
+	 *
+	 * @note This must be set before calling `start`.
+	 */
+	std::shared_ptr<buffer_pool> buffers{};
+
+	/**
+	 * @brief Called with each message an rcon++ server sends through `rcon_server::broadcast`, on the thread reading from the server.
+	 * A message too big for one packet arrives in parts, one call each.
+	 *
+	 * @note This must be set before calling `start`.
+	 */
+	std::function<void(std::string_view message)> on_broadcast{};
+
+	/**
+	 * @brief Called with each log line, if its level is at least `min_log_level`.
+	 */
 	std::function<void(const std::string_view& log)> on_log{};
 
+	/**
+	 * @brief Like `on_log`, but given the record itself (its level, event, request ID, and so on) rather than a line of text.
+	 * If only this is set, no log lines are formatted at all.
+	 */
+	std::function<void(const log_record& record)> on_log_record{};
+
+	/**
+	 * @brief Records below this level are thrown away before anything is formatted. This can be changed at any time.
+	 *
+	 * @note Records below `RCONPP_MIN_LOG_LEVEL` are thrown away whatever this is set to.
+	 */
+	std::atomic<log_level> min_log_level{LOG_INFO};
+
 	std::condition_variable terminating;
 
 	/**
@@ -54,8 +348,8 @@ public:
 	 * @param _port The port to connect to.
 	 * @param pass The password for the RCON server you are connecting to.
 	 *
-	 * @note This is a blocking call (done on purpose). It needs to wait to connect to the RCON server before anything else happens.
-	 * It will timeout after 4 seconds if it can't connect.
+	 * @note `start` is a blocking call (done on purpose). It needs to wait to connect to the RCON server before anything else happens.
+	 * It will timeout after `connect_timeout` if it can't connect, and `request_timeout` if the server doesn't answer the login.
 	 */
 	rcon_client(std::string_view addr, int _port, std::string_view pass);
 
@@ -63,36 +357,123 @@ public:
 
 	void start(bool return_after);
 
+	/**
+	 * @brief Have this client's socket watched by one of `context`'s threads, rather than starting threads of its own.
+	 * This must be called before `start`.
+	 *
+	 * @param context The context to attach to. It must outlive this client.
+	 *
+	 * @note Callbacks are called from the context's thread, so they shouldn't block (or call `send_data_sync`), as every client on that thread waits on them.
+	 */
+	void attach(rcon_io_context& context);
+
 	/**
 	 * @brief Send data to the connected RCON server. Requests from this function are added to a queue (`requests_queued`) and are handled by a different thread.
 	 *
+	 * Requests don't wait for each other. Many can be waiting on a response at once, and responses are matched to requests by their ID.
+	 *
 	 * @param data Data to send to the server.
 	 * @param id ID of the packet. Try to make sure you aren't sending multiple requests, at the same time, with the same ID as it may cause issues.
+	 * Negative IDs are kept for the server (like `BROADCAST_PACKET_ID`), so requests using one are refused.
+	 * IDs from `INTERNAL_ID_START` up are handed out by `send` and used for terminators, so pick IDs below it.
 	 * @param type The type of packet to send.
-	 * @param callback The callback function that will fire when the data is returned.
+	 * @param callback The callback function that will fire when the data is returned. This is called from the thread reading responses.
+	 * @param deadline When to give up waiting on the response, on the steady clock (optional, by default `request_timeout` after it's sent).
 	 *
-	 * @warning If you are expecting no response from the server, do NOT use the callback. You will halt the RCON process until the next received message (which will chain).
+	 * @warning If you are expecting no response from the server, do NOT use the callback. It will only fire once the request times out.
+	 * Do not call `send_data_sync` from inside the callback, as the response it waits for can't be read until the callback returns.
 	 */
-	void send_data(const std::string_view data, const int32_t id, const data_type type, std::function<void(const response& retrieved_data)> callback = {}) {
-		requests_queued.emplace_back(queued_request{ std::string{data}, id, type, std::move(callback) });
+	void send_data(const std::string_view data, const int32_t id, const data_type type, std::function<void(const response& retrieved_data)> callback = {}, const std::chrono::steady_clock::time_point deadline = {}) {
+		requests_in_flight.fetch_add(1, std::memory_order_relaxed);
+		requests_queued.push(queued_request{ std::string{data}, id, type, std::move(callback), deadline });
+
+		if (attached_loop) {
+			schedule_drain();
+		}
 	}
 
+	/**
+	 * @brief Send a command to the connected RCON server, with an ID picked for you.
+	 *
+	 * IDs come from an internal counter (starting at `INTERNAL_ID_START`), so any number of threads can send at once without clashing.
+	 *
+	 * @param command The command to send.
+	 * @param type The type of packet to send.
+	 * @param deadline When to give up waiting on the response, on the steady clock (optional, by default `request_timeout` after it's sent).
+	 *
+	 * @returns A future that is completed once the response arrives (or the request times out).
+	 * If we're not connected, the future is completed straight away with a response the server didn't respond to.
+	 */
+	std::future<response> send(std::string_view command, data_type type = SERVERDATA_EXECCOMMAND, std::chrono::steady_clock::time_point deadline = {});
+
+	/**
+	 * @brief Send several commands to the connected RCON server in one go, with IDs picked for you.
+	 *
+	 * Every command is queued at once, so they are encoded back to back and sent together (usually in a single write),
+	 * rather than one write per command.
+	 *
+	 * @param commands The commands to send, in order. These only need to stay alive until this returns.
+	 * @param type The type of packet to send.
+	 * @param deadline When to give up waiting on the responses, on the steady clock (optional, by default `request_timeout` after they're sent).
+	 *
+	 * @returns A future that is completed once every command has its response (or has timed out), with one response per command, in the same order as `commands`.
+	 */
+	std::future<std::vector<response>> send_batch(const std::vector<std::string_view>& commands, data_type type = SERVERDATA_EXECCOMMAND, std::chrono::steady_clock::time_point deadline = {});
+
+#ifdef RCONPP_CORO
+	/**
+	 * @brief Send a command to the connected RCON server and `co_await` the response, with an ID picked for you.
+	 *
+	 * @param command The command to send. This only needs to stay alive until the `co_await` suspends.
+	 * @param type The type of packet to send.
+	 *
+	 * @returns An awaitable that gives the response once it arrives (or the request times out).
+	 */
+	command_awaitable execute(std::string_view command, data_type type = SERVERDATA_EXECCOMMAND) {
+		return command_awaitable(*this, command, type, allocate_internal_id());
+	}
+#endif
+
 	/**
 	 * @brief Send data to the connected RCON server.
 	 *
 	 * @param data Data to send to the server.
 	 * @param id ID of the packet. Try to make sure you aren't sending multiple requests, at the same time, with the same ID as it may cause issues.
+	 * Negative IDs are kept for the server (like `BROADCAST_PACKET_ID`), so requests using one are refused.
+	 * IDs from `INTERNAL_ID_START` up are handed out by `send` and used for terminators, so pick IDs below it.
 	 * @param type The type of packet to send.
 	 * @param feedback Should the client expect a message back from the server? (optional, default is true).
+	 * @param deadline When to give up waiting on the response, on the steady clock (optional, by default `request_timeout` from now).
 	 *
-	 * @warning If you are expecting no response from the server, set `feedback` to false. Otherwise, you will halt the RCON process for 4 seconds.
+	 * @warning If you are expecting no response from the server, set `feedback` to false. Otherwise, this call will block until the request times out.
 	 *
 	 * @returns Data given by the server from the request.
 	 */
-	response send_data_sync(std::string_view data, int32_t id, data_type type, bool feedback = true);
+	response send_data_sync(std::string_view data, int32_t id, data_type type, bool feedback = true, std::chrono::steady_clock::time_point deadline = {});
+
+	/**
+	 * @returns How many requests are queued or waiting on a response. Requests without a callback stop counting once they're sent.
+	 */
+	size_t in_flight() const {
+		return requests_in_flight.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @returns Request, packet, and byte counts, plus how long requests have taken. This is safe to call from any thread.
+	 */
+	client_metrics metrics() const;
 
 private:
 
+	/**
+	 * @brief Hands `record` to `on_log_record` and `on_log`, if its level is high enough. Nothing is formatted otherwise.
+	 */
+	void log(const log_record& record) const {
+		if (record.level >= MIN_LOG_LEVEL && record.level >= min_log_level.load(std::memory_order_relaxed)) {
+			emit_log(record, on_log, on_log_record);
+		}
+	}
+
 	/**
 	 * @brief Connects to RCON using `address`, `port`, and `password`.
 	 * Those values are pre-filled when constructing this class.
@@ -102,22 +483,155 @@ private:
 	 */
 	bool connect_to_server();
 
+	/**
+	 * @brief Queues a request and returns a future for its response.
+	 */
+	std::future<response> queue_request(std::string_view data, int32_t id, data_type type, std::chrono::steady_clock::time_point deadline);
+
+	enum read_result {
+		READ_OK = 0,
+		READ_TIMED_OUT = 1,
+		READ_FAILED = 2,
+	};
+
 	/**
 	 * @brief Ask to receive information from the server for a specified ID.
 	 *
 	 * @param id The ID that we should except the server to return, alongside information.
 	 * @param type The type of packet that we should expect.
+	 * @param terminator_id The ID of the empty packet sent after the request, which marks the end of the response (0 if one wasn't sent).
+	 * @param deadline When to give up, on the steady clock. This holds across every read, however the response is split up.
 	 *
 	 * @return Data given by the server.
+	 *
+	 * @warning This reads from the socket itself, so should only be used before `response_reader` starts (during login).
+	 */
+	response receive_information(int32_t id, data_type type, int32_t terminator_id, std::chrono::steady_clock::time_point deadline);
+
+	/**
+	 * @brief Gets the next packet from `decoder`, reading from the socket (in chunks of `READ_CHUNK_SIZE`) only when it has run out.
+	 *
+	 * @param packet Where to put the packet. Its body only lasts until the next read.
+	 * @param deadline When to give up, on the steady clock. Left empty, reads only give up on the socket's own timeout.
+	 *
+	 * @return READ_TIMED_OUT if no packet arrived in time, READ_FAILED if the connection broke (or we gave up part way through a packet).
+	 */
+	read_result read_packet(decoded_packet& packet, std::chrono::steady_clock::time_point deadline);
+
+	/**
+	 * @brief Remembers every request in `batch` that wants a response, and adds their packets onto the end of `buffer`.
+	 *
+	 * @returns When `expire_requests` next needs to run for the requests just added.
 	 */
-	response receive_information(int32_t id, data_type type);
+	std::chrono::steady_clock::time_point encode_requests(std::vector<queued_request>& batch, std::vector<char>& buffer);
 
 	/**
-	 * @brief Gathers all the packet's content (based on the length returned by `read_packet_length`)
+	 * @brief Sends every request in `batch` in one go, remembering those that want a response.
+	 * If the send fails, we disconnect and every request waiting on a response is failed.
 	 *
-	 * @return A packet structure containing the length, size, data, and if server responded.
+	 * @returns When `expire_requests` next needs to run for the requests just sent.
+	 */
+	std::chrono::steady_clock::time_point send_requests(std::vector<queued_request>& batch);
+
+	/**
+	 * @brief Posts `drain_requests` to `attached_loop`, unless it's already waiting to run.
+	 */
+	void schedule_drain();
+
+	/**
+	 * @brief Puts our socket on `attached_loop`. Runs on the loop's thread once we've logged in.
+	 */
+	void register_with_loop();
+
+	/**
+	 * @brief Sends everything in `requests_queued`. Runs on the loop's thread.
 	 */
-	packet read_packet();
+	void drain_requests();
+
+	/**
+	 * @brief Sends as much of `write_buffer` as the socket will take without blocking.
+	 *
+	 * @returns false if the connection broke.
+	 */
+	bool flush_writes();
+
+	/**
+	 * @brief Called by `attached_loop` when our socket can be read from or written to.
+	 */
+	void on_socket_event(uint32_t events);
+
+	/**
+	 * @brief Hands every whole packet in `decoder` to the request it belongs to.
+	 *
+	 * @returns false if the server sent something that can't be a packet.
+	 */
+	bool parse_responses();
+
+	/**
+	 * @brief Takes an attached client off its loop after the connection broke, failing everything it was waiting on.
+	 */
+	void lose_connection();
+
+	/**
+	 * @brief Takes our socket off `attached_loop`, for good. Runs on the loop's thread.
+	 */
+	void detach_from_loop();
+
+	/**
+	 * @brief Runs on `response_reader`, reading packets until we disconnect.
+	 */
+	void read_responses();
+
+	/**
+	 * @returns true if a packet with a body this size is the last one `request` will get.
+	 */
+	bool response_finished(const pending_request& request, size_t body_size) const;
+
+	/**
+	 * @brief Hands a received packet to the request it belongs to (if any), completing the request if that was the last of it.
+	 */
+	void deliver_packet(const decoded_packet& packet);
+
+	/**
+	 * @brief Removes a request from `pending_requests` and fires its callback.
+	 */
+	void complete_request(int32_t id, bool server_responded);
+
+	/**
+	 * @brief Completes every request that has passed its deadline, or whose response has gone quiet for `DEFAULT_TIMEOUT`.
+	 *
+	 * @returns When this next needs to run, or `time_point::max()` if nothing is waiting on a response.
+	 */
+	std::chrono::steady_clock::time_point expire_requests();
+
+	/**
+	 * @brief Completes every request as failed, used once we've disconnected.
+	 */
+	void fail_all_requests();
+
+	/**
+	 * @return An ID for a packet rcon++ is sending on its own.
+	 */
+	int32_t allocate_internal_id();
+
+	/**
+	 * @brief Fails every request still waiting in `requests_queued`, so nothing is left waiting on a request that will never be sent.
+	 */
+	void fail_queued_requests();
 };
 
+#ifdef RCONPP_CORO
+inline bool command_awaitable::await_ready() const noexcept {
+	return !client.connected;
+}
+
+inline void command_awaitable::await_suspend(std::coroutine_handle<> handle) {
+	// Only `this` and the handle are captured, small enough for std::function to keep inline on the usual standard libraries.
+	client.send_data(command, id, type, [this, handle](const response& retrieved_data) {
+		result = retrieved_data;
+		handle.resume();
+	});
+}
+#endif
+
 } // namespace rconpp
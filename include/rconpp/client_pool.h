@@ -0,0 +1,194 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "buffer_pool.h"
+#include "client.h"
+#include "export.h"
+#include "utilities.h"
+
+namespace rconpp {
+
+/**
+ * @brief Keeps several logged in connections to one RCON server, and spreads requests across them.
+ *
+ * Each request goes to the connected client with the fewest requests in flight. Clients that lose their connection
+ * are replaced in the background, so callers only ever see the `send_data`/`send_data_sync`/`send` functions.
+ */
+class RCONPP_EXPORT rcon_client_pool {
+	const std::string address{};
+	const int port{0};
+	const std::string password{};
+	const size_t pool_size{0};
+
+	/**
+	 * @brief Shared by every client in the pool. A client replacing a dead one picks up the buffers the dead one left behind.
+	 */
+	std::shared_ptr<buffer_pool> buffers{std::make_shared<buffer_pool>()};
+
+	/**
+	 * @brief Every client in the pool. Sending takes a shared lock, replacing a client takes an exclusive lock.
+	 * Clients are never destroyed while a sender can still see them.
+	 */
+	std::vector<std::unique_ptr<rcon_client>> clients{};
+
+	mutable std::shared_mutex clients_mutex;
+
+	/**
+	 * @brief Where the next search for a client starts, so idle clients take turns rather than the first one doing everything.
+	 */
+	mutable std::atomic<size_t> next_client{0};
+
+	std::thread maintainer;
+	std::mutex maintainer_mutex;
+	std::condition_variable maintainer_wake;
+
+	/**
+	 * @brief Both are only set with `maintainer_mutex` held, so `maintainer` can't miss them. `stopping` is also read without the lock, between connections.
+	 */
+	std::atomic<bool> stopping{false};
+	bool maintenance_requested{false};
+
+	/**
+	 * @brief Creates and logs in a new client. The client will not be connected if the login failed.
+	 */
+	std::unique_ptr<rcon_client> make_client();
+
+	/**
+	 * @brief Picks the connected client with the fewest requests in flight.
+	 *
+	 * @warning `clients_mutex` must be held (shared is enough) for as long as the client is used.
+	 *
+	 * @returns The client, or nullptr if none are connected.
+	 */
+	rcon_client* pick_client() const;
+
+	/**
+	 * @brief Runs on `maintainer`, replacing clients that have disconnected.
+	 */
+	void maintain();
+
+	/**
+	 * @brief Wakes `maintainer` up early, used when a dead client is noticed.
+	 */
+	void request_maintenance();
+
+	/**
+	 * @brief Hands `record` to `on_log_record` and `on_log`, if its level is high enough. Nothing is formatted otherwise.
+	 */
+	void log(const log_record& record) const {
+		if (record.level >= MIN_LOG_LEVEL && record.level >= min_log_level.load(std::memory_order_relaxed)) {
+			emit_log(record, on_log, on_log_record);
+		}
+	}
+
+public:
+	/**
+	 * @brief How long the maintainer waits between checking for dead clients.
+	 */
+	std::chrono::milliseconds maintenance_interval{1000};
+
+	/**
+	 * @brief Called with every new client before it connects, so settings like `multi_packet` can be changed.
+	 */
+	std::function<void(rcon_client& client)> setup_client{};
+
+	/**
+	 * @brief Logs from the pool and every client in it.
+	 *
+	 * @note This must be set before calling `start`. Use `setup_client` to change each client's `min_log_level`.
+	 */
+	std::function<void(const std::string_view& log)> on_log{};
+
+	/**
+	 * @brief Log records from the pool and every client in it. See `rcon_client::on_log_record`.
+	 *
+	 * @note This must be set before calling `start`.
+	 */
+	std::function<void(const log_record& record)> on_log_record{};
+
+	/**
+	 * @brief The pool's own records below this level are thrown away before anything is formatted. This can be changed at any time.
+	 * Each client has its own, which can be changed through `setup_client`.
+	 */
+	std::atomic<log_level> min_log_level{LOG_INFO};
+
+	/**
+	 * @brief rcon_client_pool constructor.
+	 *
+	 * @param addr The IP Address (NOT domain) to connect to.
+	 * @param _port The port to connect to.
+	 * @param pass The password for the RCON server you are connecting to.
+	 * @param size How many connections to keep open (at least one).
+	 */
+	rcon_client_pool(std::string_view addr, int _port, std::string_view pass, size_t size);
+
+	/**
+	 * @brief Stops replacing clients and disconnects every client. Requests still waiting on a response are failed.
+	 */
+	~rcon_client_pool();
+
+	rcon_client_pool(const rcon_client_pool&) = delete;
+	rcon_client_pool& operator=(const rcon_client_pool&) = delete;
+
+	/**
+	 * @brief Connects every client at once, then starts replacing any that disconnect.
+	 *
+	 * @note This blocks until every client has connected or given up (which takes as long as the slowest one).
+	 *
+	 * @returns true if at least one client connected.
+	 */
+	bool start();
+
+	/**
+	 * @brief Send data through the least busy client. See `rcon_client::send_data`.
+	 *
+	 * @note IDs only need to be unique per client, but the pool doesn't say which client a request goes to, so keep them unique across the pool.
+	 * If no client is connected, the callback is called straight away with a response the server didn't respond to.
+	 */
+	void send_data(std::string_view data, int32_t id, data_type type, std::function<void(const response& retrieved_data)> callback = {}, std::chrono::steady_clock::time_point deadline = {});
+
+	/**
+	 * @brief Send data through the least busy client, and wait for the response. See `rcon_client::send_data_sync`.
+	 */
+	response send_data_sync(std::string_view data, int32_t id, data_type type, bool feedback = true, std::chrono::steady_clock::time_point deadline = {});
+
+	/**
+	 * @brief Send a command through the least busy client, with an ID picked for you. See `rcon_client::send`.
+	 */
+	std::future<response> send(std::string_view command, data_type type = SERVERDATA_EXECCOMMAND, std::chrono::steady_clock::time_point deadline = {});
+
+	/**
+	 * @brief Send several commands through the least busy client, all together. See `rcon_client::send_batch`.
+	 */
+	std::future<std::vector<response>> send_batch(const std::vector<std::string_view>& commands, data_type type = SERVERDATA_EXECCOMMAND, std::chrono::steady_clock::time_point deadline = {});
+
+	/**
+	 * @returns How many clients are currently connected.
+	 */
+	size_t connected_count() const;
+
+	/**
+	 * @returns How often a new client has been given buffers an old client left behind, rather than new ones.
+	 */
+	buffer_pool_stats buffer_stats() const {
+		return buffers->stats();
+	}
+
+	/**
+	 * @returns How many clients the pool keeps.
+	 */
+	size_t size() const {
+		return pool_size;
+	}
+};
+
+} // namespace rconpp
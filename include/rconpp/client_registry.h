@@ -0,0 +1,172 @@
+#pragma once
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <netinet/in.h>
+#endif
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include "export.h"
+#include "utilities.h"
+
+namespace rconpp {
+
+struct connected_client {
+	sockaddr_in sock_info{};
+	SOCKET_TYPE socket{0};
+
+	/**
+	 * @brief Given to the client when it connects, and never given to another. Sockets are reused once closed, this isn't.
+	 */
+	uint64_t id{0};
+
+	bool connected{false};
+	bool authenticated{false};
+	uint8_t authentication_attempts{0}; // Will never exceed MAX_AUTHENTICATION_ATTEMPTS
+
+	/**
+	 * @brief When the client connected, or was last sent a heartbeat, in seconds since the epoch.
+	 */
+	time_t last_heartbeat{0};
+};
+
+/**
+ * @brief Every client connected to a server, safe to read and change from any thread.
+ *
+ * Clients are split over `SHARD_COUNT` maps by socket, each with its own lock, so clients connecting and disconnecting
+ * on different loops rarely wait on each other. Locks are only held long enough to touch a single entry.
+ *
+ * Listing every client (`snapshot`) hands out an immutable copy that's shared until something changes,
+ * so admin listings don't take any of the registry's locks unless a client has come or gone since the last one.
+ */
+class RCONPP_EXPORT client_registry {
+public:
+	/**
+	 * @brief A list of clients, as they were when it was taken. It never changes, so it can be read on any thread for as long as it's held.
+	 */
+	using client_list = std::shared_ptr<const std::vector<connected_client>>;
+
+	static constexpr size_t SHARD_COUNT = 16;
+
+private:
+	/**
+	 * @brief Kept on its own cache line, so threads working on different shards don't slow each other down.
+	 */
+	struct alignas(64) shard {
+		mutable std::mutex mutex;
+		std::unordered_map<SOCKET_TYPE, connected_client> clients{};
+	};
+
+	struct cached_list {
+		/**
+		 * @brief The value of `version` when the list was taken.
+		 */
+		uint64_t version{0};
+		std::vector<connected_client> clients{};
+	};
+
+	std::array<shard, SHARD_COUNT> shards{};
+
+	/**
+	 * @brief Goes up on every change, so `snapshot` knows when its cached list is out of date.
+	 */
+	alignas(64) std::atomic<uint64_t> version{0};
+	std::atomic<size_t> count{0};
+
+	/**
+	 * @brief The last list `snapshot` built. Only swapped whole, through `std::atomic_load` and `std::atomic_store`.
+	 */
+	mutable std::shared_ptr<const cached_list> cached{};
+
+	/**
+	 * @brief Only one thread rebuilds the list at a time, the others wait for its result rather than doing the same work.
+	 */
+	mutable std::mutex rebuild_mutex;
+
+	shard& shard_for(const SOCKET_TYPE socket) {
+		return shards[static_cast<size_t>(socket) % SHARD_COUNT];
+	}
+
+	const shard& shard_for(const SOCKET_TYPE socket) const {
+		return shards[static_cast<size_t>(socket) % SHARD_COUNT];
+	}
+
+public:
+	client_registry() = default;
+
+	client_registry(const client_registry&) = delete;
+	client_registry& operator=(const client_registry&) = delete;
+
+	/**
+	 * @brief Add a client, replacing any client already on the same socket.
+	 */
+	void insert(const connected_client& client);
+
+	/**
+	 * @brief Forget the client on a socket.
+	 *
+	 * @returns false if there was no client on that socket.
+	 */
+	bool erase(SOCKET_TYPE socket);
+
+	/**
+	 * @returns A copy of the client on a socket, or nothing if there isn't one.
+	 */
+	std::optional<connected_client> find(SOCKET_TYPE socket) const;
+
+	/**
+	 * @returns true if there is a client on the socket.
+	 */
+	bool contains(SOCKET_TYPE socket) const;
+
+	/**
+	 * @brief Change the client on a socket in place.
+	 *
+	 * @param socket The client's socket.
+	 * @param change Called with the client, while its shard is locked. Keep it short, and don't call back into the registry from it.
+	 *
+	 * @returns false if there was no client on that socket, so `change` wasn't called.
+	 */
+	template <typename function>
+	bool update(const SOCKET_TYPE socket, function&& change) {
+		shard& target = shard_for(socket);
+		std::lock_guard lock(target.mutex);
+
+		auto found = target.clients.find(socket);
+
+		if (found == target.clients.end()) {
+			return false;
+		}
+
+		change(found->second);
+		version.fetch_add(1, std::memory_order_release);
+
+		return true;
+	}
+
+	/**
+	 * @returns Every client, as they were at some point during the call. The list is shared, and only rebuilt when something has changed since the last one.
+	 */
+	client_list snapshot() const;
+
+	/**
+	 * @returns How many clients there are.
+	 */
+	size_t size() const {
+		return count.load(std::memory_order_relaxed);
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+};
+
+} // namespace rconpp
@@ -0,0 +1,390 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "export.h"
+#include "metrics.h"
+
+namespace rconpp {
+
+struct command_view;
+
+/**
+ * @brief Hash a verb. This is FNV-1a with a final mix, and can be worked out at compile time.
+ *
+ * @param verb The verb to hash.
+ * @param seed Changes the hash completely, used to find a hash with no collisions for `static_command_table`.
+ *
+ * @returns The verb's hash.
+ */
+constexpr uint32_t hash_verb(const std::string_view verb, const uint32_t seed = 0) {
+	uint32_t hash = 2166136261u ^ (seed * 0x9E3779B9u);
+
+	for (const char c : verb) {
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 16777619u;
+	}
+
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6Bu;
+	hash ^= hash >> 13;
+
+	return hash;
+}
+
+/**
+ * @brief A fixed set of verbs, with a perfect hash (every verb gets its own slot, no probing) worked out at compile time.
+ *
+ * Give it to `command_router::use_table` and every verb in it is found with two hashes and one comparison.
+ *
+ * @code
+ * static constexpr rconpp::static_command_table<3> admin_verbs({ "kick", "ban", "say" });
+ * static_assert(admin_verbs.valid(), "Every verb must be different.");
+ * @endcode
+ */
+template <size_t N>
+class static_command_table {
+	static_assert(N > 0, "A static_command_table needs at least one verb.");
+
+	/**
+	 * @brief How many seeds to try for one bucket before giving up. Only reached when two verbs are the same.
+	 */
+	static constexpr uint32_t MAX_SEED = 1u << 16;
+
+	std::array<std::string_view, N> verbs{};
+
+	/**
+	 * @brief For each bucket: the seed to hash its verbs with (above 0), the slot of its only verb (below 0, as -(slot + 1)), or 0 if it's empty.
+	 */
+	std::array<int32_t, N> displacements{};
+
+	/**
+	 * @brief For each slot, which verb is in it.
+	 */
+	std::array<int32_t, N> slots{};
+
+	bool built{true};
+
+public:
+	constexpr explicit static_command_table(const std::array<std::string_view, N>& _verbs) : verbs(_verbs) {
+		std::array<size_t, N> bucket_of{};
+		std::array<size_t, N> bucket_size{};
+		std::array<size_t, N> order{};
+
+		for (size_t i = 0; i < N; i++) {
+			bucket_of[i] = hash_verb(verbs[i]) % N;
+			bucket_size[bucket_of[i]]++;
+			slots[i] = -1;
+			order[i] = i;
+		}
+
+		// Buckets with the most verbs are placed first, while there are still plenty of free slots.
+		for (size_t i = 1; i < N; i++) {
+			for (size_t j = i; j > 0 && bucket_size[order[j]] > bucket_size[order[j - 1]]; j--) {
+				const size_t swapped = order[j];
+				order[j] = order[j - 1];
+				order[j - 1] = swapped;
+			}
+		}
+
+		for (size_t o = 0; o < N && built; o++) {
+			const size_t bucket = order[o];
+
+			if (bucket_size[bucket] == 0) {
+				break;
+			}
+
+			// A verb on its own can go in any free slot, so it's just told where.
+			if (bucket_size[bucket] == 1) {
+				size_t verb = 0;
+				size_t slot = 0;
+
+				while (bucket_of[verb] != bucket) {
+					verb++;
+				}
+
+				while (slots[slot] != -1) {
+					slot++;
+				}
+
+				slots[slot] = static_cast<int32_t>(verb);
+				displacements[bucket] = -static_cast<int32_t>(slot + 1);
+				continue;
+			}
+
+			bool placed = false;
+
+			for (uint32_t seed = 1; seed < MAX_SEED && !placed; seed++) {
+				std::array<size_t, N> chosen{};
+				size_t chosen_count = 0;
+				placed = true;
+
+				for (size_t i = 0; i < N && placed; i++) {
+					if (bucket_of[i] != bucket) {
+						continue;
+					}
+
+					const size_t slot = hash_verb(verbs[i], seed) % N;
+
+					if (slots[slot] != -1) {
+						placed = false;
+					}
+
+					for (size_t c = 0; c < chosen_count && placed; c++) {
+						if (chosen[c] == slot) {
+							placed = false;
+						}
+					}
+
+					chosen[chosen_count++] = slot;
+				}
+
+				if (!placed) {
+					continue;
+				}
+
+				chosen_count = 0;
+
+				for (size_t i = 0; i < N; i++) {
+					if (bucket_of[i] == bucket) {
+						slots[chosen[chosen_count++]] = static_cast<int32_t>(i);
+					}
+				}
+
+				displacements[bucket] = static_cast<int32_t>(seed);
+			}
+
+			built = placed;
+		}
+	}
+
+	/**
+	 * @returns false if the table couldn't be built, which only happens when a verb is in it twice.
+	 */
+	constexpr bool valid() const {
+		return built;
+	}
+
+	/**
+	 * @returns The position of `verb` in the array the table was made from, or -1 if it isn't in the table.
+	 */
+	constexpr int32_t find(const std::string_view verb) const {
+		const int32_t displacement = displacements[hash_verb(verb) % N];
+
+		if (displacement == 0) {
+			return -1;
+		}
+
+		const size_t slot = displacement < 0 ? static_cast<size_t>(-displacement - 1) : hash_verb(verb, static_cast<uint32_t>(displacement)) % N;
+		const int32_t index = slots[slot];
+
+		return index >= 0 && verbs[static_cast<size_t>(index)] == verb ? index : -1;
+	}
+
+	constexpr size_t size() const {
+		return N;
+	}
+
+	constexpr std::string_view verb(const size_t index) const {
+		return verbs[index];
+	}
+};
+
+/**
+ * @brief The arguments after a command's verb, split on spaces as they're asked for. Nothing is copied or allocated.
+ *
+ * Arguments wrapped in double quotes can have spaces in them, the quotes aren't part of the argument.
+ */
+class RCONPP_EXPORT command_args {
+	std::string_view rest{};
+
+public:
+	command_args() = default;
+
+	explicit command_args(const std::string_view _rest) : rest(_rest) {}
+
+	/**
+	 * @returns The next argument, or an empty view once there are none left.
+	 */
+	std::string_view next();
+
+	/**
+	 * @returns Everything not taken by `next` yet, without the spaces in front of it. Useful for commands like `say` that take a sentence.
+	 */
+	std::string_view remaining() const;
+
+	/**
+	 * @returns true if there are no arguments left.
+	 */
+	bool empty() const {
+		return remaining().empty();
+	}
+
+	/**
+	 * @returns How many arguments are left, without taking any of them.
+	 */
+	size_t count() const;
+};
+
+/**
+ * @brief How often a verb has been used, and how long its handler took.
+ */
+struct command_stats {
+	std::string verb{};
+	uint64_t calls{0};
+	std::chrono::nanoseconds total_time{0};
+	std::chrono::nanoseconds max_time{0};
+
+	/**
+	 * @brief Every call's handler time, for percentiles.
+	 */
+	histogram_snapshot latency{};
+};
+
+/**
+ * @brief Sends each command to the handler registered for its verb (the first word of the command).
+ *
+ * Verbs are found through a hash table, so routing takes the same time with 5 verbs or 500.
+ * For a fixed set of verbs known at compile time, `use_table` swaps in a perfect hash.
+ *
+ * @note Register every handler before the server starts. Routing may happen on several threads at once, but adding verbs may not.
+ */
+class RCONPP_EXPORT command_router {
+public:
+	/**
+	 * @brief Handles a single verb.
+	 *
+	 * @param command The whole command, and the client that sent it.
+	 * @param args The arguments after the verb.
+	 *
+	 * @returns The response to send back.
+	 */
+	using handler = std::function<std::string(const command_view& command, command_args args)>;
+
+private:
+	struct route {
+		std::string verb{};
+		uint32_t hash{0};
+		handler function{};
+
+		latency_histogram latency{};
+	};
+
+	/**
+	 * @brief Every verb, in the order they were added. Routes never move, as the table refers to them by position.
+	 */
+	std::vector<std::unique_ptr<route>> routes{};
+
+	/**
+	 * @brief Open addressing table of positions in `routes` (-1 for an empty slot). Always a power of two, and at most half full.
+	 */
+	std::vector<int32_t> table{};
+
+	/**
+	 * @brief The table given to `use_table`, and how to search it without knowing its size.
+	 */
+	const void* static_table{nullptr};
+	int32_t (*static_find)(const void* table, std::string_view verb){nullptr};
+
+	/**
+	 * @brief For each verb in `static_table`, its position in `routes` (-1 if it has no handler).
+	 */
+	std::vector<int32_t> static_routes{};
+
+	std::atomic<uint64_t> unrouted_commands{0};
+
+	/**
+	 * @returns The position of `verb` in `routes`, or -1.
+	 */
+	int32_t find(std::string_view verb) const;
+
+	/**
+	 * @brief Rebuilds `table`, big enough for `routes` to stay at most half full.
+	 */
+	void rebuild_table();
+
+	/**
+	 * @brief Points every verb in `static_table` at its route.
+	 */
+	void link_static_routes();
+
+public:
+	command_router() = default;
+
+	command_router(const command_router&) = delete;
+	command_router& operator=(const command_router&) = delete;
+
+	/**
+	 * @brief Handle every command starting with `verb`. Adding a verb twice replaces its handler.
+	 */
+	void add(std::string_view verb, handler function);
+
+	/**
+	 * @brief Find verbs in `fixed_verbs` with its perfect hash first, before the hash table. Verbs not in it still work as before.
+	 *
+	 * @param fixed_verbs The table to use. It must outlive the router, so should be `static constexpr`.
+	 */
+	template <size_t N>
+	void use_table(const static_command_table<N>& fixed_verbs) {
+		static_table = &fixed_verbs;
+		static_find = [](const void* table, const std::string_view verb) {
+			return static_cast<const static_command_table<N>*>(table)->find(verb);
+		};
+
+		static_routes.assign(N, -1);
+		link_static_routes();
+	}
+
+	/**
+	 * @brief Run the handler for a command's verb, if there is one.
+	 *
+	 * @param command The command to route.
+	 * @param response Where to put the handler's response.
+	 *
+	 * @returns false if no handler has that verb, leaving `response` alone.
+	 */
+	bool dispatch(const command_view& command, std::string& response);
+
+	/**
+	 * @returns true if a handler has been added for the verb `command` starts with.
+	 */
+	bool handles(std::string_view command) const;
+
+	/**
+	 * @returns true if no verbs have been added.
+	 */
+	bool empty() const {
+		return routes.empty();
+	}
+
+	/**
+	 * @returns How often each verb has been used, and how long its handler took.
+	 */
+	std::vector<command_stats> stats() const;
+
+	/**
+	 * @returns How many commands didn't match any verb.
+	 */
+	uint64_t unrouted() const {
+		return unrouted_commands.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Splits a command into its verb and its arguments.
+	 *
+	 * @param command The whole command.
+	 * @param args Set to everything after the verb.
+	 *
+	 * @returns The verb, without any spaces around it.
+	 */
+	static std::string_view split(std::string_view command, command_args& args);
+};
+
+} // namespace rconpp
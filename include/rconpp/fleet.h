@@ -0,0 +1,136 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "client.h"
+#include "export.h"
+#include "log.h"
+#include "utilities.h"
+
+namespace rconpp {
+
+/**
+ * @brief Where to find an RCON server, and how to log in to it.
+ */
+struct rcon_endpoint {
+	/**
+	 * @brief The IP Address (NOT domain) of the server.
+	 */
+	std::string address{};
+	int port{0};
+	std::string password{};
+};
+
+enum fleet_status {
+	/**
+	 * @brief The command ran and the full response came back.
+	 */
+	FLEET_OK = 0,
+
+	/**
+	 * @brief We couldn't connect to the server (bad address, refused, or unreachable).
+	 */
+	FLEET_CONNECT_FAILED = 1,
+
+	/**
+	 * @brief The server refused the password.
+	 */
+	FLEET_AUTH_FAILED = 2,
+
+	/**
+	 * @brief The server didn't finish responding before `rcon_fleet::timeout`. Anything it did send is still in the response.
+	 */
+	FLEET_TIMED_OUT = 3,
+
+	/**
+	 * @brief The server closed the connection (or sent something that wasn't a packet) before responding.
+	 */
+	FLEET_DISCONNECTED = 4,
+};
+
+/**
+ * @brief What happened when a command was run on one server.
+ */
+struct fleet_result {
+	fleet_status status{FLEET_TIMED_OUT};
+
+	response result{};
+
+	/**
+	 * @brief How long it took to connect, from the start of `rcon_fleet::execute`.
+	 */
+	std::chrono::microseconds connect_time{0};
+
+	/**
+	 * @brief How long it took to be logged in, from the start of `rcon_fleet::execute`.
+	 */
+	std::chrono::microseconds auth_time{0};
+
+	/**
+	 * @brief How long it took to get the whole response (or give up), from the start of `rcon_fleet::execute`.
+	 */
+	std::chrono::microseconds total_time{0};
+};
+
+/**
+ * @brief Runs one command on many RCON servers at once.
+ *
+ * Every server is connected to, logged in to, and sent the command at the same time, all from a single event loop on the calling thread.
+ * The login and the command go out in the same write, so the whole thing takes about as long as the slowest server, rather than the sum of them all.
+ */
+class RCONPP_EXPORT rcon_fleet {
+public:
+	/**
+	 * @brief How responses that are split over multiple packets should be detected. See `multi_packet_mode`.
+	 */
+	multi_packet_mode multi_packet{MULTI_PACKET_TERMINATOR};
+
+	/**
+	 * @brief The body size of a full packet, used by `MULTI_PACKET_SIZE`.
+	 */
+	size_t full_packet_body_size{MAX_PACKET_SIZE - MIN_PACKET_SIZE};
+
+	/**
+	 * @brief Packets claiming to be bigger than this end that server's session, so a broken server can't make us allocate whatever it likes.
+	 */
+	int max_packet_size{MAX_PACKET_SIZE * 4};
+
+	/**
+	 * @brief How long each server gets to connect, log in, and respond, before it is given up on.
+	 */
+	std::chrono::milliseconds timeout{DEFAULT_TIMEOUT * 1000};
+
+	/**
+	 * @brief Called with a line of text for each server that fails, if its level is at least `min_log_level`.
+	 */
+	std::function<void(const std::string_view& log)> on_log{};
+
+	/**
+	 * @brief Like `on_log`, but given the record itself. The server's address is in `log_record::text`. See `rcon_client::on_log_record`.
+	 */
+	std::function<void(const log_record& record)> on_log_record{};
+
+	/**
+	 * @brief Records below this level are thrown away before anything is formatted.
+	 *
+	 * @note Records below `RCONPP_MIN_LOG_LEVEL` are thrown away whatever this is set to.
+	 */
+	log_level min_log_level{LOG_INFO};
+
+	/**
+	 * @brief Run a command on every server in `endpoints`.
+	 *
+	 * @param endpoints The servers to run the command on.
+	 * @param command The command to run.
+	 *
+	 * @returns One result per endpoint, in the same order as `endpoints`.
+	 *
+	 * @note This blocks until every server has responded, failed, or timed out.
+	 */
+	std::vector<fleet_result> execute(const std::vector<rcon_endpoint>& endpoints, std::string_view command);
+};
+
+} // namespace rconpp
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "buffer_pool.h"
+#include "export.h"
+#include "reactor.h"
+
+namespace rconpp {
+
+class rcon_client;
+
+/**
+ * @brief A small set of event loop threads that any number of `rcon_client`s can share.
+ *
+ * A client normally has two threads of its own, one sending requests and one blocked in `recv` waiting on responses.
+ * Clients attached to a context (see `rcon_client::attach`) use non-blocking sockets instead, and have their sockets
+ * watched by the context's threads, so hundreds of mostly idle clients only cost a few threads.
+ *
+ * @warning The context must outlive every client attached to it.
+ */
+class RCONPP_EXPORT rcon_io_context {
+	friend class rcon_client;
+
+	struct io_loop {
+		reactor events{};
+		std::thread runner;
+
+		/**
+		 * @brief Every client whose socket is on this loop. Only touched on the loop's thread.
+		 */
+		std::unordered_set<rcon_client*> clients{};
+
+		/**
+		 * @brief `clients` copied out for the tick to walk, kept between ticks so it doesn't allocate.
+		 */
+		std::vector<rcon_client*> ticking{};
+	};
+
+	std::vector<std::unique_ptr<io_loop>> loops{};
+	std::atomic<size_t> next_loop{0};
+
+	/**
+	 * @brief Given to every client attached without a pool of its own.
+	 */
+	std::shared_ptr<buffer_pool> buffers{std::make_shared<buffer_pool>()};
+
+	/**
+	 * @returns The loop the next attached client should use. Clients are spread across loops round-robin.
+	 */
+	io_loop& pick_loop();
+
+public:
+	/**
+	 * @brief rcon_io_context constructor. Starts the loop threads straight away.
+	 *
+	 * @param threads How many event loop threads to run (at least one will always be started).
+	 */
+	explicit rcon_io_context(unsigned int threads = 1);
+
+	/**
+	 * @brief Stops and joins every loop thread.
+	 */
+	~rcon_io_context();
+
+	rcon_io_context(const rcon_io_context&) = delete;
+	rcon_io_context& operator=(const rcon_io_context&) = delete;
+
+	/**
+	 * @returns How often an attached client has been given buffers an older client left behind, rather than new ones.
+	 */
+	buffer_pool_stats buffer_stats() const {
+		return buffers->stats();
+	}
+
+	/**
+	 * @returns How many loop threads the context has.
+	 */
+	size_t size() const {
+		return loops.size();
+	}
+};
+
+} // namespace rconpp
@@ -0,0 +1,237 @@
+#pragma once
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "export.h"
+#include "utilities.h"
+
+/**
+ * @brief Log records below this level are thrown away where they're made, without being checked at runtime.
+ * Set through the `RCONPP_MIN_LOG_LEVEL` CMake option, as a number (0 for `LOG_TRACE` up to 5 for `LOG_OFF`).
+ */
+#ifndef RCONPP_MIN_LOG_LEVEL
+	#define RCONPP_MIN_LOG_LEVEL 0
+#endif
+
+namespace rconpp {
+
+enum log_level : uint8_t {
+	/**
+	 * @brief Every packet, and everything done with it.
+	 */
+	LOG_TRACE = 0,
+
+	/**
+	 * @brief Every command and response.
+	 */
+	LOG_DEBUG = 1,
+
+	/**
+	 * @brief Connections, logins, and the server or client starting and stopping.
+	 */
+	LOG_INFO = 2,
+
+	/**
+	 * @brief Something went wrong with a single client or request, but everything else carries on.
+	 */
+	LOG_WARNING = 3,
+
+	/**
+	 * @brief Something went wrong that stops the server or client working.
+	 */
+	LOG_ERROR = 4,
+
+	/**
+	 * @brief Log nothing at all.
+	 */
+	LOG_OFF = 5,
+};
+
+constexpr log_level MIN_LOG_LEVEL = static_cast<log_level>(RCONPP_MIN_LOG_LEVEL);
+
+/**
+ * @brief What a `log_record` is about. Each event only fills in the fields of `log_record` that it needs.
+ */
+enum log_event : uint16_t {
+	// Server events.
+	EVENT_SERVER_STARTING = 0,
+	EVENT_SERVER_LISTENING,
+	EVENT_SERVER_READY,
+	EVENT_SERVER_START_FAILED,
+	EVENT_SERVER_STOPPING,
+	EVENT_CLIENT_CONNECTING,
+	EVENT_CLIENT_CONNECTED,
+	EVENT_CLIENT_DISCONNECTED,
+	EVENT_CLIENT_DROPPED,
+	EVENT_CLIENT_UNKNOWN,
+	EVENT_ACCEPT_FAILED,
+	EVENT_WATCH_FAILED,
+	EVENT_AUTH_STARTED,
+	EVENT_AUTH_SUCCEEDED,
+	EVENT_AUTH_FAILED,
+	EVENT_AUTH_ATTEMPTS_EXCEEDED,
+	EVENT_INVALID_PACKET_TYPE,
+	EVENT_COMMAND_RECEIVED,
+	EVENT_NO_COMMAND_HANDLER,
+	EVENT_HANDLER_QUEUE_FULL,
+	EVENT_RESPONSE_SENT,
+	EVENT_HEARTBEAT_SENT,
+	EVENT_HEARTBEAT_FAILED,
+	EVENT_BROADCAST_DROPPED,
+	EVENT_AUTH_TIMED_OUT,
+	EVENT_CLIENT_IDLE,
+
+	// Client events.
+	EVENT_CLIENT_STOPPING,
+	EVENT_CONNECTING,
+	EVENT_CONNECT_FAILED,
+	EVENT_CONNECT_TIMED_OUT,
+	EVENT_LOGGING_IN,
+	EVENT_LOGGED_IN,
+	EVENT_LOGIN_FAILED,
+	EVENT_NOT_CONNECTED,
+	EVENT_REQUEST_TOO_BIG,
+	EVENT_DUPLICATE_REQUEST_ID,
+	EVENT_RESPONSE_TIMED_OUT,
+	EVENT_CONNECTION_LOST,
+	EVENT_ALREADY_ATTACHED,
+	EVENT_INVALID_ADDRESS,
+	EVENT_INVALID_REQUEST_ID,
+
+	// Client pool events.
+	EVENT_POOL_STARTED,
+	EVENT_POOL_NOT_CONNECTED,
+	EVENT_POOL_CLIENT_REPLACED,
+
+	// Fleet events, about one of the servers a command is being run on.
+	EVENT_FLEET_INVALID_ADDRESS,
+	EVENT_FLEET_SOCKET_FAILED,
+	EVENT_FLEET_CONNECT_FAILED,
+	EVENT_FLEET_SEND_FAILED,
+	EVENT_FLEET_AUTH_FAILED,
+	EVENT_FLEET_INVALID_PACKET,
+	EVENT_FLEET_CLOSED,
+	EVENT_FLEET_TIMED_OUT,
+
+	// Events for both.
+	EVENT_INVALID_PORT,
+	EVENT_STARTUP_FAILED,
+	EVENT_SOCKET_FAILED,
+	EVENT_SEND_FAILED,
+	EVENT_RECEIVE_FAILED,
+	EVENT_INVALID_PACKET_SIZE,
+};
+
+/**
+ * @brief Something that happened, as typed fields. Making one doesn't allocate or format anything,
+ * that only happens if `message` is called (which is only done when something is going to see the record).
+ *
+ * @warning `text` points at memory owned by whoever made the record, so a record is only valid until the log callback returns.
+ */
+struct RCONPP_EXPORT log_record {
+	log_level level{LOG_INFO};
+	log_event event{EVENT_SERVER_STARTING};
+
+	/**
+	 * @brief The other end's IPv4 address (in network byte order) and port, or 0 if there isn't one.
+	 */
+	uint32_t address{0};
+	uint16_t port{0};
+
+	SOCKET_TYPE socket{INVALID_SOCKET};
+
+	/**
+	 * @brief A packet (or request) ID, or for `EVENT_INVALID_PACKET_TYPE`, the packet type.
+	 * For `EVENT_POOL_STARTED` it's how many clients the pool has, and for fleet events the server's port as it was given.
+	 */
+	int32_t id{0};
+
+	/**
+	 * @brief How many packets a response was split over, for `EVENT_RESPONSE_SENT`, or how many bytes were waiting to be sent, for `EVENT_BROADCAST_DROPPED`.
+	 * For `EVENT_POOL_STARTED` it's how many of the pool's clients connected.
+	 */
+	size_t size{0};
+
+	int error_code{0};
+
+	/**
+	 * @brief A command or response, or for fleet events, the server's address as it was given.
+	 */
+	std::string_view text{};
+
+	constexpr log_record(const log_level _level, const log_event _event) : level(_level), event(_event) {}
+
+	log_record& from(const sockaddr_in& peer) {
+		address = peer.sin_addr.s_addr;
+		port = ntohs(peer.sin_port);
+		return *this;
+	}
+
+	log_record& with_socket(const SOCKET_TYPE _socket) {
+		socket = _socket;
+		return *this;
+	}
+
+	log_record& with_id(const int32_t _id) {
+		id = _id;
+		return *this;
+	}
+
+	log_record& with_size(const size_t _size) {
+		size = _size;
+		return *this;
+	}
+
+	log_record& with_error(const int _error_code) {
+		error_code = _error_code;
+		return *this;
+	}
+
+	log_record& with_text(const std::string_view _text) {
+		text = _text;
+		return *this;
+	}
+
+	/**
+	 * @returns `address` and `port`, like `127.0.0.1:27015`.
+	 */
+	std::string peer() const;
+
+	/**
+	 * @returns The record as a line of text, which is what `on_log` is given.
+	 */
+	std::string message() const;
+};
+
+/**
+ * @returns The level's name, like `info`.
+ */
+RCONPP_EXPORT std::string_view level_name(log_level level);
+
+/**
+ * @returns The event's name, like `auth_failed`.
+ */
+RCONPP_EXPORT std::string_view event_name(log_event event);
+
+/**
+ * @brief Hands a record to whichever log callbacks are set, only formatting it if `on_log` is set.
+ */
+template <typename text_callback, typename record_callback>
+void emit_log(const log_record& record, const text_callback& on_log, const record_callback& on_log_record) {
+	if (on_log_record) {
+		on_log_record(record);
+	}
+
+	if (on_log) {
+		on_log(record.message());
+	}
+}
+
+} // namespace rconpp
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "export.h"
+#include "log.h"
+
+namespace rconpp {
+
+enum log_overflow {
+	/**
+	 * @brief Throw the record away (and count it in `log_sink_stats::dropped`), so whoever is logging never waits.
+	 */
+	LOG_OVERFLOW_DROP = 0,
+
+	/**
+	 * @brief Wait for the writer thread to make room. Nothing is lost, but a slow writer slows down whoever is logging.
+	 */
+	LOG_OVERFLOW_BLOCK = 1,
+};
+
+/**
+ * @brief A record that has been through an `async_log_sink`, and when it was logged.
+ */
+struct log_entry {
+	/**
+	 * @brief The record. Its text now belongs to the sink, and lasts until the batch it's in has been written.
+	 */
+	log_record record{LOG_INFO, EVENT_SERVER_STARTING};
+
+	std::chrono::system_clock::time_point time{};
+};
+
+struct log_sink_stats {
+	/**
+	 * @brief Records written out, to the file or the batch callback.
+	 */
+	uint64_t written{0};
+
+	/**
+	 * @brief Records thrown away because the queue was full (or the sink was stopping).
+	 */
+	uint64_t dropped{0};
+
+	/**
+	 * @brief How many batches the records were written in.
+	 */
+	uint64_t batches{0};
+
+	/**
+	 * @brief Records waiting to be written right now.
+	 */
+	size_t queued{0};
+};
+
+/**
+ * @brief Writes log records on a thread of its own, so a slow disk (or a slow callback) never holds up a server or client.
+ *
+ * Records are copied into a fixed size, lock-free ring when they're logged. The writer thread takes everything waiting at once
+ * and writes it as one batch, so under load many records share a single write. Once the ring has been round once,
+ * logging a record no longer allocates anything.
+ *
+ * @code
+ * rconpp::async_log_sink audit("rcon-audit.log");
+ *
+ * server.min_log_level = rconpp::LOG_DEBUG;
+ * server.on_log_record = [&audit](const rconpp::log_record& record) {
+ *     audit.push(record);
+ * };
+ * @endcode
+ *
+ * @note The sink must outlive anything logging to it. Records still queued when it's destroyed are written first.
+ */
+class RCONPP_EXPORT async_log_sink {
+public:
+	/**
+	 * @brief Writes a batch of records. Called on the sink's thread, one batch at a time.
+	 */
+	using batch_writer = std::function<void(const std::vector<log_entry>& batch)>;
+
+private:
+	struct slot {
+		/**
+		 * @brief Which lap of the ring this slot is ready for. See `try_push` and `pop_batch`.
+		 */
+		std::atomic<size_t> sequence{0};
+
+		log_record record{LOG_INFO, EVENT_SERVER_STARTING};
+
+		/**
+		 * @brief A copy of the record's text. Keeps its capacity, so slots stop allocating once they've seen a long enough line.
+		 */
+		std::string text{};
+
+		std::chrono::system_clock::time_point time{};
+	};
+
+	std::unique_ptr<slot[]> slots{};
+	size_t mask{0};
+
+	const log_overflow overflow{LOG_OVERFLOW_DROP};
+
+	/**
+	 * @brief Positions in the ring. Records are claimed at `enqueue_position` by any thread, and taken from `dequeue_position` by the writer.
+	 * Kept on their own cache lines, so producers and the writer don't slow each other down.
+	 */
+	alignas(64) std::atomic<size_t> enqueue_position{0};
+	alignas(64) std::atomic<size_t> dequeue_position{0};
+
+	/**
+	 * @brief Every record before this position has been written.
+	 */
+	alignas(64) std::atomic<size_t> written_position{0};
+
+	std::atomic<uint64_t> written{0};
+	std::atomic<uint64_t> dropped{0};
+	std::atomic<uint64_t> batches{0};
+
+	batch_writer writer{};
+	std::FILE* file{nullptr};
+
+	/**
+	 * @brief Records taken from the ring, and the text they point at. Only touched by `runner`.
+	 */
+	std::vector<log_entry> batch{};
+	std::vector<std::string> batch_text{};
+	std::string file_buffer{};
+
+	std::atomic<bool> stopping{false};
+	std::atomic<bool> sleeping{false};
+	bool signalled{false};
+	std::mutex wake_mutex;
+	std::condition_variable wake_condition;
+	std::condition_variable written_condition;
+
+	std::thread runner;
+
+	/**
+	 * @brief Sets up the ring and starts `runner`.
+	 */
+	void start(size_t capacity);
+
+	/**
+	 * @brief Copies a record into the next free slot.
+	 *
+	 * @returns false if the ring is full.
+	 */
+	bool try_push(const log_record& record);
+
+	/**
+	 * @brief Moves everything waiting in the ring (up to a batch) into `batch`.
+	 *
+	 * @returns How many records were taken.
+	 */
+	size_t pop_batch();
+
+	/**
+	 * @brief Hands `batch` to `writer`, or writes it to `file`.
+	 */
+	void write_batch();
+
+	/**
+	 * @brief Wakes `runner` if it's asleep.
+	 */
+	void wake();
+
+	void run();
+
+public:
+	/**
+	 * @brief Write records to a file as lines of text, after the time, level, and event name. The file is appended to.
+	 *
+	 * @param path The file to write to.
+	 * @param capacity How many records can be waiting to be written (rounded up to a power of two).
+	 * @param overflow What to do with records logged while the queue is full.
+	 */
+	explicit async_log_sink(const std::string& path, size_t capacity = 8192, log_overflow overflow = LOG_OVERFLOW_DROP);
+
+	/**
+	 * @brief Hand records to a callback, in batches.
+	 *
+	 * @param batch_callback Called with each batch, on the sink's thread.
+	 * @param capacity How many records can be waiting to be written (rounded up to a power of two).
+	 * @param overflow What to do with records logged while the queue is full.
+	 */
+	explicit async_log_sink(batch_writer batch_callback, size_t capacity = 8192, log_overflow overflow = LOG_OVERFLOW_DROP);
+
+	/**
+	 * @brief Writes everything still queued, then stops the thread and closes the file.
+	 */
+	~async_log_sink();
+
+	async_log_sink(const async_log_sink&) = delete;
+	async_log_sink& operator=(const async_log_sink&) = delete;
+
+	/**
+	 * @brief Queue a record to be written. This is safe to call from any thread, and with `LOG_OVERFLOW_DROP` never waits.
+	 *
+	 * @returns false if the record was dropped.
+	 *
+	 * @warning With `LOG_OVERFLOW_BLOCK`, don't push from inside the batch callback. The writer can't make room while it's waiting on itself.
+	 */
+	bool push(const log_record& record);
+
+	/**
+	 * @brief Wait until every record pushed before this call has been written.
+	 */
+	void flush();
+
+	/**
+	 * @returns false if the file couldn't be opened. Records are still taken, and counted as written, but go nowhere.
+	 */
+	bool is_open() const {
+		return file != nullptr || writer != nullptr;
+	}
+
+	log_sink_stats stats() const;
+
+	/**
+	 * @returns A record as a line of text (without the newline), like `2024-01-01T12:00:00.000Z warning auth_failed Client [...] failed authentication!`.
+	 */
+	static std::string format(const log_entry& entry);
+};
+
+} // namespace rconpp
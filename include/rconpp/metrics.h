@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "export.h"
+
+namespace rconpp {
+
+/**
+ * @brief A count that only goes up, which any thread can add to without a lock.
+ */
+class metric_counter {
+	std::atomic<uint64_t> value{0};
+
+public:
+	void add(const uint64_t amount = 1) {
+		value.fetch_add(amount, std::memory_order_relaxed);
+	}
+
+	uint64_t load() const {
+		return value.load(std::memory_order_relaxed);
+	}
+};
+
+/**
+ * @brief A copy of a `latency_histogram` at one point in time.
+ */
+struct RCONPP_EXPORT histogram_snapshot {
+	uint64_t count{0};
+	std::chrono::nanoseconds sum{0};
+	std::chrono::nanoseconds min{0};
+	std::chrono::nanoseconds max{0};
+
+	/**
+	 * @brief How many values landed in each bucket. See `latency_histogram` for what each bucket covers.
+	 */
+	std::vector<uint64_t> buckets{};
+
+	/**
+	 * @param percent From 0 to 100, like 99 for p99.
+	 *
+	 * @returns The value `percent`% of values were at or below (accurate to about 3%), or 0 if nothing was recorded.
+	 */
+	std::chrono::nanoseconds percentile(double percent) const;
+
+	/**
+	 * @returns The average value, or 0 if nothing was recorded.
+	 */
+	std::chrono::nanoseconds mean() const;
+};
+
+/**
+ * @brief Counts how long things took, keeping enough detail to find percentiles later (like HdrHistogram).
+ *
+ * Each power of two is split into 32 buckets, so a value is only ever placed within about 3% of where it really was.
+ * Values go from 1 nanosecond up to about 18 minutes (anything longer is counted as 18 minutes).
+ * Recording is a handful of relaxed atomic adds, so any thread can do it on a hot path.
+ */
+class RCONPP_EXPORT latency_histogram {
+public:
+	static constexpr int SUB_BUCKET_BITS = 5;
+	static constexpr uint64_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static constexpr int MAX_EXPONENT = 40;
+	static constexpr size_t BUCKET_COUNT = SUB_BUCKETS + (MAX_EXPONENT - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+private:
+	std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets{};
+	std::atomic<uint64_t> count{0};
+	std::atomic<uint64_t> sum{0};
+	std::atomic<uint64_t> min{UINT64_MAX};
+	std::atomic<uint64_t> max{0};
+
+public:
+	/**
+	 * @returns The bucket a value (in nanoseconds) belongs to.
+	 */
+	static size_t bucket_for(uint64_t value);
+
+	/**
+	 * @returns The biggest value (in nanoseconds) that belongs in a bucket.
+	 */
+	static uint64_t bucket_upper_bound(size_t bucket);
+
+	void record(std::chrono::nanoseconds duration);
+
+	histogram_snapshot snapshot() const;
+};
+
+/**
+ * @brief Builds text in the Prometheus exposition format, which most metrics tools can read (or scrape) as is.
+ *
+ * Counters become `<name>_total`, and histograms become a summary of p50, p90, p99, and p99.9 (in seconds) with `_count` and `_sum`.
+ */
+class RCONPP_EXPORT metrics_writer {
+	std::string text{};
+
+public:
+	/**
+	 * @param name The counter's name, without `_total`.
+	 * @param help What the counter counts.
+	 * @param value The counter's value.
+	 */
+	void counter(std::string_view name, std::string_view help, uint64_t value);
+
+	/**
+	 * @param name The histogram's name.
+	 * @param help What the histogram measures.
+	 * @param labels Labels for this histogram, like `verb="kick"`, or empty for none.
+	 * @param histogram The histogram.
+	 * @param describe false if a histogram with the same name (but other labels) has already been written.
+	 */
+	void histogram(std::string_view name, std::string_view help, std::string_view labels, const histogram_snapshot& histogram, bool describe = true);
+
+	/**
+	 * @returns A label to pass to `histogram`, like `verb="kick"`, with any quotes or backslashes in `value` escaped.
+	 */
+	static std::string label(std::string_view name, std::string_view value);
+
+	/**
+	 * @returns Everything written so far.
+	 */
+	const std::string& str() const {
+		return text;
+	}
+};
+
+} // namespace rconpp
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace rconpp {
+
+/**
+ * @brief An unbounded queue that many threads can push to without locking, and one thread pops from.
+ *
+ * Pushing is a single atomic exchange, so producers never wait on each other or on the consumer.
+ * The consumer can sleep in `wait` when the queue is empty, which costs no CPU until the next push.
+ *
+ * @note Only one thread may call `try_pop` and `wait` at a time.
+ */
+template <typename T>
+class mpsc_queue {
+	struct node {
+		std::atomic<node*> next{nullptr};
+		T value{};
+	};
+
+	/**
+	 * @brief The most recently pushed node. Producers swap themselves in here.
+	 */
+	std::atomic<node*> head;
+
+	/**
+	 * @brief The last node the consumer has taken. Its `next` is the next value to pop.
+	 */
+	node* tail;
+
+	std::atomic<bool> sleeping{false};
+	bool signalled{false};
+	std::mutex sleep_mutex;
+	std::condition_variable sleep_condition;
+
+	void notify() {
+		std::lock_guard lock(sleep_mutex);
+		signalled = true;
+		sleep_condition.notify_one();
+	}
+
+	/**
+	 * @brief Put an already linked chain of nodes onto the end of the queue.
+	 */
+	void link(node* first, node* last) {
+		node* previous = head.exchange(last, std::memory_order_acq_rel);
+		previous->next.store(first, std::memory_order_seq_cst);
+
+		// Pairs with `wait`. Only producers that race with the consumer going to sleep pay for the lock.
+		if (sleeping.load(std::memory_order_seq_cst)) {
+			notify();
+		}
+	}
+
+public:
+	mpsc_queue() {
+		node* stub = new node();
+		head.store(stub);
+		tail = stub;
+	}
+
+	~mpsc_queue() {
+		T discarded{};
+		while (try_pop(discarded)) {}
+		delete tail;
+	}
+
+	mpsc_queue(const mpsc_queue&) = delete;
+	mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+	/**
+	 * @brief Add a value to the queue, waking the consumer if it's waiting. This is safe to call from any thread.
+	 *
+	 * @param value The value to add.
+	 */
+	void push(T value) {
+		node* added = new node();
+		added->value = std::move(value);
+
+		link(added, added);
+	}
+
+	/**
+	 * @brief Add several values to the queue at once. The consumer sees either none of them or all of them, never some.
+	 *
+	 * @param values The values to add, in order.
+	 */
+	void push_all(std::vector<T> values) {
+		node* first = nullptr;
+		node* last = nullptr;
+
+		// The chain is built privately first, so it costs the same single exchange as one push.
+		for (T& value : values) {
+			node* added = new node();
+			added->value = std::move(value);
+
+			if (last) {
+				last->next.store(added, std::memory_order_relaxed);
+			} else {
+				first = added;
+			}
+
+			last = added;
+		}
+
+		if (first) {
+			link(first, last);
+		}
+	}
+
+	/**
+	 * @brief Take the oldest value from the queue.
+	 *
+	 * @param value Where to put the value.
+	 *
+	 * @returns true if a value was taken, false if the queue is empty.
+	 */
+	bool try_pop(T& value) {
+		node* next = tail->next.load(std::memory_order_acquire);
+
+		if (!next) {
+			return false;
+		}
+
+		value = std::move(next->value);
+
+		delete tail;
+		tail = next;
+
+		return true;
+	}
+
+	/**
+	 * @returns true if there is nothing to pop. Only meaningful on the consumer thread.
+	 */
+	bool empty() const {
+		return tail->next.load(std::memory_order_seq_cst) == nullptr;
+	}
+
+	/**
+	 * @brief Sleep until something is pushed or `wake` is called. Returns straight away if the queue isn't empty.
+	 */
+	void wait() {
+		std::unique_lock lock(sleep_mutex);
+
+		sleeping.store(true, std::memory_order_seq_cst);
+
+		if (empty()) {
+			sleep_condition.wait(lock, [this]() { return signalled; });
+		}
+
+		signalled = false;
+		sleeping.store(false, std::memory_order_seq_cst);
+	}
+
+	/**
+	 * @brief Like `wait`, but also gives up at `deadline`.
+	 */
+	void wait_until(const std::chrono::steady_clock::time_point deadline) {
+		std::unique_lock lock(sleep_mutex);
+
+		sleeping.store(true, std::memory_order_seq_cst);
+
+		if (empty()) {
+			sleep_condition.wait_until(lock, deadline, [this]() { return signalled; });
+		}
+
+		signalled = false;
+		sleeping.store(false, std::memory_order_seq_cst);
+	}
+
+	/**
+	 * @brief Wake the consumer up from `wait` (or `wait_until`) without pushing anything, used for shutting down.
+	 */
+	void wake() {
+		notify();
+	}
+};
+
+} // namespace rconpp
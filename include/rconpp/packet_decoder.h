@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "export.h"
+#include "utilities.h"
+
+namespace rconpp {
+
+/**
+ * @brief A packet pulled out of a `packet_decoder`.
+ */
+struct decoded_packet {
+	int32_t id{0};
+	int32_t type{0};
+
+	/**
+	 * @brief The packet's body, without the two null bytes after it.
+	 *
+	 * @warning This points into the decoder, so only lasts until the decoder is next given data (`prepare` or `feed`).
+	 */
+	std::string_view body{};
+};
+
+enum decode_result {
+	/**
+	 * @brief A whole packet was decoded.
+	 */
+	DECODE_PACKET = 0,
+
+	/**
+	 * @brief There isn't a whole packet yet, read some more.
+	 */
+	DECODE_NEED_MORE = 1,
+
+	/**
+	 * @brief The stream has a packet size that can't be right (negative, or over the limit), so nothing after it can be trusted.
+	 */
+	DECODE_INVALID = 2,
+};
+
+/**
+ * @brief Turns a stream of bytes back into packets, however the bytes were split up when they were read.
+ *
+ * Sockets are read straight into the decoder in big chunks (see `prepare`), so one `recv` can bring in any number of
+ * packets, and a packet can be split over any number of `recv`s. Packet sizes are checked before anything is waited on,
+ * so a bad size never makes the decoder grow.
+ *
+ * Bytes that have been decoded are only moved when there isn't room at the end for the next read,
+ * and a decoder that is emptied every read never moves anything at all.
+ */
+class RCONPP_EXPORT packet_decoder {
+	std::vector<char> storage{};
+
+	/**
+	 * @brief Where the next undecoded byte is in `storage`.
+	 */
+	size_t read_offset{0};
+
+	/**
+	 * @brief Where the next received byte goes in `storage`.
+	 */
+	size_t write_offset{0};
+
+public:
+	/**
+	 * @brief Make room for at least `size` more bytes, so a socket can be read straight into the decoder.
+	 * Follow this with `commit` to say how many bytes were actually read.
+	 *
+	 * @param size How many bytes the next read may bring in.
+	 *
+	 * @returns Where to put the bytes.
+	 *
+	 * @warning This can move undecoded bytes, so any `decoded_packet` from before this call is no longer valid.
+	 */
+	char* prepare(size_t size);
+
+	/**
+	 * @brief Adds `size` bytes, written to the space given by `prepare`, to the stream.
+	 */
+	void commit(size_t size);
+
+	/**
+	 * @brief Copies bytes onto the end of the stream. The same as `prepare`, `memcpy`, then `commit`.
+	 */
+	void feed(const char* data, size_t size);
+
+	/**
+	 * @brief Pulls the next whole packet out of the stream. Packets too small to have an ID and type are skipped.
+	 *
+	 * @param packet Where to put the packet, only changed when this returns DECODE_PACKET.
+	 * @param max_packet_size The biggest packet size (everything after the size field) to accept.
+	 *
+	 * @returns DECODE_PACKET if `packet` was filled in, DECODE_NEED_MORE if more bytes are needed first,
+	 * or DECODE_INVALID if the stream is broken (this keeps being returned until `clear` is called).
+	 *
+	 * @note Call this until it stops returning DECODE_PACKET before reading more, so the decoder never holds more than one partial packet.
+	 */
+	decode_result next(decoded_packet& packet, int32_t max_packet_size);
+
+	/**
+	 * @returns How many bytes are waiting to be decoded (part of a packet, usually).
+	 */
+	size_t buffered() const {
+		return write_offset - read_offset;
+	}
+
+	/**
+	 * @brief Throws away everything in the stream, keeping the memory for the next connection.
+	 */
+	void clear();
+
+	/**
+	 * @brief Use `buffer` (from a `buffer_pool`, usually) to hold the stream. Anything already in the stream is thrown away.
+	 */
+	void use_buffer(std::vector<char>&& buffer);
+
+	/**
+	 * @brief Hand the decoder's buffer back (to give to a `buffer_pool`, usually), leaving the decoder empty.
+	 */
+	std::vector<char> release_buffer();
+};
+
+} // namespace rconpp
@@ -5,6 +5,18 @@
 #endif
 
 #include "export.h"
+#include "reactor.h"
+#include "buffer_pool.h"
+#include "client_registry.h"
 #include "client.h"
+#include "client_pool.h"
+#include "command_router.h"
+#include "fleet.h"
+#include "io_context.h"
+#include "log.h"
+#include "log_sink.h"
+#include "metrics.h"
+#include "packet_decoder.h"
 #include "server.h"
+#include "timer_wheel.h"
 #include "utilities.h"
@@ -0,0 +1,208 @@
+#pragma once
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <WS2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "export.h"
+#include "utilities.h"
+
+namespace rconpp {
+
+enum io_event : uint32_t {
+	/**
+	 * @brief The socket has data to read (or a pending connection, for listening sockets).
+	 */
+	IO_READABLE = 1 << 0,
+
+	/**
+	 * @brief The socket can accept more data to send.
+	 */
+	IO_WRITABLE = 1 << 1,
+
+	/**
+	 * @brief The socket was closed by the other side or is in an error state.
+	 */
+	IO_CLOSED = 1 << 2,
+};
+
+/**
+ * @brief A single threaded event loop that waits on socket readiness.
+ *
+ * On Linux this is backed by `epoll`, every other platform uses `poll` (or `WSAPoll` on Windows).
+ * Sockets handed to a reactor should be non-blocking, as callbacks are expected to read/write until the socket would block.
+ *
+ * @warning `add`, `modify`, and `remove` must only be called from the thread running `run` (or before `run` is called).
+ * Use `post` to get work onto the loop from any other thread.
+ */
+class RCONPP_EXPORT reactor {
+public:
+	using io_callback = std::function<void(uint32_t events)>;
+
+private:
+	struct io_handler {
+		io_callback callback;
+		uint32_t events{0};
+	};
+
+	std::unordered_map<SOCKET_TYPE, std::shared_ptr<io_handler>> handlers{};
+
+#ifdef __linux__
+	int epoll_fd{-1};
+	int wake_fd{-1};
+#else
+	SOCKET_TYPE wake_receiver{INVALID_SOCKET};
+	SOCKET_TYPE wake_sender{INVALID_SOCKET};
+#endif
+
+	std::mutex tasks_mutex;
+	std::vector<std::function<void()>> tasks{};
+	std::atomic<bool> wake_pending{false};
+
+	std::atomic<bool> running{false};
+	std::atomic<std::thread::id> loop_thread{};
+
+	/**
+	 * @brief Set once `run` has returned, after its last tasks have run. Anything posted from then on will never run.
+	 */
+	std::atomic<bool> finished{false};
+
+	std::chrono::milliseconds tick_interval{0};
+	std::function<void()> on_tick{};
+	std::chrono::steady_clock::time_point next_tick{};
+
+	/**
+	 * @brief Wait for events (at most `timeout` milliseconds) and dispatch them to their handlers.
+	 */
+	void poll_once(int timeout);
+
+	/**
+	 * @brief Interrupt a thread that is currently waiting in `poll_once`.
+	 */
+	void wake();
+
+	/**
+	 * @brief Consume the wakeup signal sent by `wake`.
+	 */
+	void drain_wake();
+
+	void dispatch(SOCKET_TYPE socket, uint32_t events);
+
+public:
+	reactor();
+
+	~reactor();
+
+	reactor(const reactor&) = delete;
+	reactor& operator=(const reactor&) = delete;
+
+	/**
+	 * @brief Start watching a socket.
+	 *
+	 * @param socket The socket to watch.
+	 * @param events A mask of `io_event` values to wait for. `IO_CLOSED` is always reported.
+	 * @param callback Called on the loop thread with the events that are ready.
+	 *
+	 * @returns true if the socket is now being watched, otherwise false.
+	 */
+	bool add(SOCKET_TYPE socket, uint32_t events, io_callback callback);
+
+	/**
+	 * @brief Change the events a watched socket is waiting for.
+	 *
+	 * @param socket The socket to modify.
+	 * @param events The new mask of `io_event` values.
+	 *
+	 * @returns true if the socket was updated, otherwise false.
+	 */
+	bool modify(SOCKET_TYPE socket, uint32_t events);
+
+	/**
+	 * @brief Stop watching a socket. This does not close the socket.
+	 *
+	 * @param socket The socket to stop watching.
+	 */
+	void remove(SOCKET_TYPE socket);
+
+	/**
+	 * @brief Queue a task to run on the loop thread. This is safe to call from any thread.
+	 *
+	 * @param task The task to run.
+	 */
+	void post(std::function<void()> task);
+
+	/**
+	 * @brief Call a function on the loop thread every `interval`.
+	 *
+	 * @param interval How often to call the function.
+	 * @param tick The function to call.
+	 *
+	 * @note Must be set before `run` is called.
+	 */
+	void set_tick(std::chrono::milliseconds interval, std::function<void()> tick);
+
+	/**
+	 * @brief Make sure the next tick happens no later than `when`. Later ticks go back to the usual interval.
+	 *
+	 * @param when When the tick is needed by, on the steady clock.
+	 *
+	 * @warning Must only be called from the loop's thread (or before `run` is called), and only once a tick has been set.
+	 */
+	void tick_before(std::chrono::steady_clock::time_point when) {
+		if (when < next_tick) {
+			next_tick = when;
+		}
+	}
+
+	/**
+	 * @brief Run the loop on the calling thread until `stop` is called.
+	 */
+	void run();
+
+	/**
+	 * @brief Ask the loop to stop. This is safe to call from any thread, `run` will return once it wakes up.
+	 */
+	void stop();
+
+	/**
+	 * @brief Run every task handed to `post` since the last call.
+	 *
+	 * @warning Must only be called from the loop's thread. `run` already does this, it's only needed when the loop's thread is
+	 * waiting on something (like another loop) and the loop's tasks have to keep moving in the meantime.
+	 */
+	void run_tasks();
+
+	/**
+	 * @returns true once `run` has returned. Tasks posted after that never run.
+	 */
+	bool stopped() const {
+		return finished.load();
+	}
+
+	/**
+	 * @returns The loop being run by the calling thread, or nullptr if it isn't running one.
+	 */
+	static reactor* current();
+
+	/**
+	 * @returns true if the calling thread is the one running the loop.
+	 */
+	bool in_loop_thread() const {
+		return loop_thread.load() == std::this_thread::get_id();
+	}
+};
+
+} // namespace rconpp
@@ -18,24 +18,140 @@
 #include <cstring>
 #include <thread>
 #include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include "buffer_pool.h"
+#include "client_registry.h"
+#include "command_router.h"
+#include "log.h"
+#include "metrics.h"
+#include "packet_decoder.h"
+#include "reactor.h"
+#include "thread_pool.h"
+#include "timer_wheel.h"
 #include "utilities.h"
 
 namespace rconpp {
 
-struct connected_client {
-	sockaddr_in sock_info{};
-	SOCKET_TYPE socket{0};
+struct client_command {
+	connected_client client;
+	std::string command{};
+};
 
-	bool connected{false};
-	bool authenticated{false};
-	uint8_t authentication_attempts{0}; // Will never exceed MAX_AUTHENTICATION_ATTEMPTS
+/**
+ * @brief A command as it was received, handed to `rcon_server::on_command_view`. Making one doesn't copy the command or the client.
+ *
+ * @warning Both the command and the client belong to the server, so a view is only valid until the handler returns.
+ * Use `to_command` for a copy that can be kept.
+ */
+struct command_view {
+	std::string_view command{};
+	const connected_client& client;
 
-	time_t last_heartbeat{0};
+	command_view(std::string_view _command, const connected_client& _client) : command(_command), client(_client) {}
+
+	/**
+	 * @returns A copy of the command and the client, which can be kept after the handler returns.
+	 */
+	client_command to_command() const {
+		return { client, std::string{command} };
+	}
 };
 
-struct client_command {
-	connected_client client;
-	std::string command{};
+/**
+ * @brief Answers a single command. Handed to `rcon_server::on_command_async` so commands can be answered later, from any thread.
+ *
+ * Copies of a responder all answer the same command. Only the first call to `respond` is sent,
+ * and if every copy is destroyed without responding, the client is sent a blank response.
+ *
+ * @note A responder can be kept past the `rcon_server` that created it. Responding then does nothing.
+ */
+class RCONPP_EXPORT command_responder {
+	friend class rcon_server;
+
+	struct state {
+		std::atomic<bool> done{false};
+		std::function<void(std::string&& response)> deliver{};
+
+		~state() {
+			if (!done.exchange(true) && deliver) {
+				deliver({});
+			}
+		}
+	};
+
+	std::shared_ptr<state> shared{};
+
+public:
+	/**
+	 * @brief Send the response to the client, using the ID of the command it is answering. This is safe to call from any thread.
+	 *
+	 * @param response The text to send back.
+	 */
+	void respond(std::string response) const {
+		if (!shared || shared->done.exchange(true)) {
+			return;
+		}
+
+		shared->deliver(std::move(response));
+	}
+
+	/**
+	 * @returns true if this command has been answered already.
+	 */
+	bool responded() const {
+		return !shared || shared->done;
+	}
+};
+
+/**
+ * @brief What an `rcon_server` has done since it was created, from `rcon_server::metrics`.
+ */
+struct RCONPP_EXPORT server_metrics {
+	uint64_t connections_accepted{0};
+	uint64_t connections_closed{0};
+	uint64_t auth_successes{0};
+	uint64_t auth_failures{0};
+	uint64_t packets_in{0};
+	uint64_t packets_out{0};
+	uint64_t bytes_in{0};
+	uint64_t bytes_out{0};
+	uint64_t heartbeats_sent{0};
+
+	/**
+	 * @brief Broadcasts queued to a client, and broadcasts a client missed because it had too much waiting to be sent.
+	 */
+	uint64_t broadcasts_sent{0};
+	uint64_t broadcasts_dropped{0};
+
+	/**
+	 * @brief Clients disconnected for not logging in within `rcon_server::auth_timeout`, or for not sending anything within `rcon_server::idle_timeout`.
+	 */
+	uint64_t auth_timeouts{0};
+	uint64_t idle_timeouts{0};
+
+	/**
+	 * @brief How long command handlers took to run (or to hand the command off, for `on_command_async`).
+	 */
+	histogram_snapshot handler_time{};
+
+	/**
+	 * @brief How long each command took from being received to its response being queued, including any time spent waiting for a handler thread.
+	 */
+	histogram_snapshot request_time{};
+
+	/**
+	 * @brief Calls and handler times for each verb in `rcon_server::commands`.
+	 */
+	std::vector<command_stats> verbs{};
+
+	/**
+	 * @returns Everything above in the Prometheus text format, with names starting `rconpp_server_`.
+	 */
+	std::string to_text() const;
 };
 
 class RCONPP_EXPORT rcon_server {
@@ -45,29 +161,283 @@ class RCONPP_EXPORT rcon_server {
 
 	SOCKET_TYPE sock{INVALID_SOCKET};
 
-	std::thread accept_connections_runner;
+	struct io_loop;
 
-	std::mutex connected_clients_mutex;
-	std::mutex request_handlers_mutex;
+	/**
+	 * @brief How finely heartbeats and timeouts are timed. They happen up to this much late.
+	 */
+	static constexpr std::chrono::milliseconds TIMER_RESOLUTION{50};
+
+	/**
+	 * @brief Everything the server tracks for a single client socket.
+	 */
+	struct connection {
+		connected_client info{};
+
+		/**
+		 * @brief The loop that owns this connection. All reads and writes for the socket happen on that loop's thread.
+		 */
+		io_loop* owner{nullptr};
+
+		/**
+		 * @brief Bytes received from the client, turned back into packets.
+		 */
+		packet_decoder decoder{};
+
+		/**
+		 * @brief A part of the outgoing stream.
+		 * When `shared` is set, the bytes live in that buffer. Otherwise, they live in `write_buffer`.
+		 */
+		struct write_segment {
+			std::shared_ptr<const std::string> shared{};
+			size_t offset{0};
+			size_t size{0};
+		};
+
+		/**
+		 * @brief Small bytes (headers, short packets) waiting to be sent. Segments point into this by offset, so it can grow freely.
+		 */
+		std::vector<char> write_buffer{};
+
+		/**
+		 * @brief Everything waiting to be sent, in order. Sent with a single scatter/gather call where possible.
+		 */
+		std::vector<write_segment> write_queue{};
+
+		/**
+		 * @brief The first segment in `write_queue` that hasn't been fully sent, and how much of it has been sent.
+		 */
+		size_t write_head{0};
+		size_t write_offset{0};
+
+		/**
+		 * @brief Bytes in `write_queue` that haven't been sent yet. Broadcasts are dropped for this client once it's above `max_pending_bytes`.
+		 */
+		size_t pending_bytes{0};
+
+		/**
+		 * @brief How many commands from this client are still waiting on a response.
+		 */
+		size_t responses_pending{0};
+
+		/**
+		 * @brief IDs of empty `SERVERDATA_RESPONSE_VALUE` packets that have to be mirrored back once `responses_pending` hits 0.
+		 */
+		std::vector<int32_t> deferred_terminators{};
+
+		/**
+		 * @brief When the client connected, last sent us anything, and was last sent a heartbeat.
+		 */
+		std::chrono::steady_clock::time_point connected_at{};
+		std::chrono::steady_clock::time_point last_received{};
+		std::chrono::steady_clock::time_point last_heartbeat{};
+
+		/**
+		 * @brief Set while the client's packets are being read and handled. Anything queued then goes out with the flush after the read.
+		 */
+		bool reading{false};
+
+		/**
+		 * @brief Fires at the soonest of the client's heartbeat, login deadline, and idle deadline. See `check_timers`.
+		 */
+		timer_wheel::timer timer{};
+	};
+
+	/**
+	 * @brief An event loop, the thread running it, and every connection it owns.
+	 * A connection stays on the same loop for its whole life, so `connections` is only touched by `runner`.
+	 */
+	struct io_loop {
+		reactor events;
+		std::thread runner;
+		rcon_server* server{nullptr};
+
+		/**
+		 * @brief Every connection's timer. Declared before `connections`, so it outlives them.
+		 */
+		timer_wheel timers{TIMER_RESOLUTION};
+
+		std::unordered_map<SOCKET_TYPE, std::shared_ptr<connection>> connections{};
+	};
+
+	std::vector<std::unique_ptr<io_loop>> loops{};
+	size_t next_loop{0};
+
+	/**
+	 * @brief Shared with every responder, so one kept past the server knows not to touch it.
+	 * Responders hold `mutex` shared while they use the server, and the destructor clears `alive` under it exclusively.
+	 */
+	struct responder_guard {
+		std::shared_mutex mutex;
+		bool alive{true};
+	};
+
+	const std::shared_ptr<responder_guard> responders = std::make_shared<responder_guard>();
+
+	/**
+	 * @brief Read and write buffers left behind by clients that have disconnected, handed to the next clients to connect.
+	 */
+	buffer_pool buffers{};
+
+	/**
+	 * @brief Runs `on_command` away from the loops when `handler_threads` is above 0.
+	 */
+	std::unique_ptr<thread_pool> command_handlers{};
+
+	/**
+	 * @brief Handed out as `connected_client::id`.
+	 */
+	std::atomic<uint64_t> next_client_id{0};
+
+	/**
+	 * @brief Everything `metrics` reports. Updated from any thread without a lock.
+	 */
+	struct metric_set {
+		metric_counter connections_accepted{};
+		metric_counter connections_closed{};
+		metric_counter auth_successes{};
+		metric_counter auth_failures{};
+		metric_counter packets_in{};
+		metric_counter packets_out{};
+		metric_counter bytes_in{};
+		metric_counter bytes_out{};
+		metric_counter heartbeats_sent{};
+		metric_counter broadcasts_sent{};
+		metric_counter broadcasts_dropped{};
+		metric_counter auth_timeouts{};
+		metric_counter idle_timeouts{};
+
+		latency_histogram handler_time{};
+		latency_histogram request_time{};
+	};
+
+	metric_set counters{};
 
 public:
-	bool online{false};
+	std::atomic<bool> online{false};
+
+	/**
+	 * @brief How many threads should handle client sockets. Each thread runs its own event loop and new clients are spread between them.
+	 *
+	 * @note This must be set before calling `start`. One thread is plenty for most servers, as it never blocks.
+	 */
+	unsigned int io_threads{1};
+
+	/**
+	 * @brief The biggest packet size (not length) the server will send or accept.
+	 * Responses that don't fit in one packet are split across as many `SERVERDATA_RESPONSE_VALUE` packets as they need.
+	 *
+	 * @note Most clients expect packets to be no bigger than `MAX_PACKET_SIZE`, only raise this if you know yours can handle it.
+	 */
+	std::atomic<int> max_packet_size{MAX_PACKET_SIZE};
+
+	/**
+	 * @brief How many worker threads should run `on_command`. When this is 0, `on_command` runs on the thread that read the packet.
+	 *
+	 * Setting this stops a slow command (like a world save) from holding up reads, writes, and heartbeats for every other client on the same loop.
+	 *
+	 * @note This must be set before calling `start`. `on_command` may then be called from several threads at once.
+	 */
+	unsigned int handler_threads{0};
+
+	/**
+	 * @brief How many commands can be waiting for a handler thread. Commands received while the queue is full get a blank response.
+	 *
+	 * @note This must be set before calling `start`. Only used when `handler_threads` is above 0.
+	 */
+	size_t handler_queue_size{1024};
+
+	/**
+	 * @brief Should each handler thread be pinned to its own CPU core?
+	 *
+	 * @note This must be set before calling `start`. Only used when `handler_threads` is above 0.
+	 */
+	bool pin_handler_threads{false};
+
+	/**
+	 * @brief The most bytes a client can have waiting to be sent before `broadcast` skips it, so a client that has stopped reading
+	 * can't make the server hold on to every broadcast. Responses to its own commands are always sent.
+	 */
+	std::atomic<size_t> max_pending_bytes{1024 * 1024};
+
+	/**
+	 * @brief How long a client can go without sending anything before it's sent a heartbeat. 0 turns heartbeats off.
+	 *
+	 * @note This must be set before calling `start`.
+	 */
+	std::chrono::milliseconds heartbeat_interval{std::chrono::seconds(HEARTBEAT_TIME)};
+
+	/**
+	 * @brief How long a client has to log in after connecting before it's disconnected. 0 lets clients take as long as they like.
+	 *
+	 * @note This must be set before calling `start`.
+	 */
+	std::chrono::milliseconds auth_timeout{0};
+
+	/**
+	 * @brief How long a client can go without sending anything before it's disconnected. Heartbeats don't count, as they're sent by us. 0 never disconnects idle clients.
+	 *
+	 * @note This must be set before calling `start`. Clients that only listen (for broadcasts, say) have to send a command now and then to stay connected.
+	 */
+	std::chrono::milliseconds idle_timeout{0};
 
 	std::function<std::string(const client_command& command)> on_command;
 
+	/**
+	 * @brief Like `on_command`, but the response is sent whenever `responder.respond` is called instead of when the function returns.
+	 *
+	 * Use this when a command has to be finished somewhere else (like your game's main thread on the next tick).
+	 * A client can have as many of these waiting as it likes. When this is set, `on_command` is not used.
+	 */
+	std::function<void(const client_command& command, command_responder responder)> on_command_async;
+
+	/**
+	 * @brief Like `on_command`, but the command is looked at where it was received instead of being copied first.
+	 * When `handler_threads` is 0, answering a command this way doesn't allocate anything besides the response.
+	 *
+	 * When this is set, `on_command` is not used. `on_command_async` still takes priority over this.
+	 */
+	std::function<std::string(const command_view& command)> on_command_view;
+
+	/**
+	 * @brief Handlers for individual verbs. A command whose verb has a handler here goes to it, and never reaches `on_command_async`, `on_command_view`, or `on_command`.
+	 *
+	 * @code
+	 * server.commands.add("say", [](const rconpp::command_view& command, rconpp::command_args args) {
+	 *     return "Said: " + std::string(args.remaining());
+	 * });
+	 * @endcode
+	 *
+	 * @note Add every handler before calling `start`.
+	 */
+	command_router commands{};
+
+	/**
+	 * @brief Called with each log line, if its level is at least `min_log_level`.
+	 */
 	std::function<void(const std::string_view log)> on_log = {};
 
-	std::condition_variable terminating;
+	/**
+	 * @brief Like `on_log`, but given the record itself (its level, event, client address, and so on) rather than a line of text.
+	 * Use this for structured logging, or to pick out events. If only this is set, no log lines are formatted at all.
+	 */
+	std::function<void(const log_record& record)> on_log_record{};
 
 	/**
-	 * @brief A map of connected clients. The key is their socket.
+	 * @brief Records below this level are thrown away before anything is formatted. This can be changed at any time.
+	 *
+	 * @note Per-command and per-packet records are `LOG_DEBUG` and `LOG_TRACE`, so are skipped by default.
+	 * Records below `RCONPP_MIN_LOG_LEVEL` are thrown away whatever this is set to.
 	 */
-	std::unordered_map<SOCKET_TYPE, connected_client> connected_clients{};
+	std::atomic<log_level> min_log_level{LOG_INFO};
+
+	std::condition_variable terminating;
 
 	/**
-	 * @brief A map of request_handlers (the thread for a client that handles all requests a client will send). The key is their socket.
+	 * @brief Every connected client, by socket. This is safe to read from any thread while the server is running,
+	 * `connected_clients.snapshot()` lists them all without holding up clients connecting or disconnecting.
 	 */
-	std::unordered_map<SOCKET_TYPE, std::thread> request_handlers{};
+	client_registry connected_clients{};
 
 	/**
 	 * @brief rcon_server constuctor. Initiates a connection to an RCON server with the parameters given.
@@ -90,11 +460,49 @@ public:
 	 *
 	 * @param client_socket The socket of the client to disconnect.
 	 * @param remove_after Should remove client from connected_clients after?
+	 *
+	 * @note This is safe to call from any thread. The socket is closed by the thread that owns it.
 	 */
 	void disconnect_client(SOCKET_TYPE client_socket, bool remove_after = true);
 
+	/**
+	 * @brief Send a message to every logged in client, as `SERVERDATA_RESPONSE_VALUE` packets with the ID `BROADCAST_PACKET_ID`.
+	 *
+	 * The message is encoded once, and every client's write queue points at the same buffer. Clients with more than `max_pending_bytes`
+	 * waiting to be sent are skipped (and counted in `server_metrics::broadcasts_dropped`), so a slow client never holds up the others.
+	 *
+	 * @param message The message to send. Messages too big for one packet are split over as many as they need.
+	 * @param filter Called with each logged in client, on the thread calling `broadcast`. Only clients it returns true for are sent the message. Left empty, every client is.
+	 *
+	 * @returns How many clients the message is being sent to.
+	 *
+	 * @note This is safe to call from any thread, including from a command handler. The message is sent by the threads that own each client.
+	 */
+	size_t broadcast(std::string_view message, const std::function<bool(const connected_client& client)>& filter = {});
+
+	/**
+	 * @returns How often a connecting client has been given buffers a disconnected client left behind, rather than new ones.
+	 */
+	buffer_pool_stats buffer_stats() const {
+		return buffers.stats();
+	}
+
+	/**
+	 * @returns Connection, packet, and byte counts, plus how long commands have taken. This is safe to call from any thread, while the server is running.
+	 */
+	server_metrics metrics() const;
+
 private:
 
+	/**
+	 * @brief Hands `record` to `on_log_record` and `on_log`, if its level is high enough. Nothing is formatted otherwise.
+	 */
+	void log(const log_record& record) const {
+		if (record.level >= MIN_LOG_LEVEL && record.level >= min_log_level.load(std::memory_order_relaxed)) {
+			emit_log(record, on_log, on_log_record);
+		}
+	}
+
 	/**
 	 * @brief Connects to RCON using `address`, `port`, and `password`.
 	 * Those values are pre-filled when constructing this class.
@@ -105,42 +513,128 @@ private:
 	bool startup_server();
 
 	/**
-	 * @brief Gathers all the packet's content (based on the length returned by `read_packet_length`)
+	 * @brief Accepts every client waiting on the listening socket and hands them out to the loops.
+	 */
+	void accept_clients();
+
+	/**
+	 * @brief Takes ownership of a newly accepted client on `loop`. Must run on `loop`'s thread.
+	 */
+	void register_connection(io_loop& loop, const std::shared_ptr<connection>& conn);
+
+	/**
+	 * @brief Handles readiness events for a client socket.
+	 */
+	void on_connection_event(io_loop& loop, SOCKET_TYPE client_socket, uint32_t events);
+
+	/**
+	 * @brief Reads everything available from the client and handles every full packet received.
+	 *
+	 * @param conn Client to read packets from.
 	 *
-	 * @param client Client to read packet from.
+	 * @returns false if the client should be disconnected, otherwise true.
 	 */
-	void read_packet(connected_client& client);
+	bool read_packets(const std::shared_ptr<connection>& conn);
 
 	/**
-	 * @brief Sends a heartbeat to a client.
+	 * @brief Handles a single packet sent by a client.
 	 *
-	 * @param client Client to send a heartbeat to.
+	 * @param conn The client that sent the packet.
+	 * @param id The ID of the packet.
+	 * @param type The type of the packet.
+	 * @param body The body of the packet (without the null terminators).
+	 */
+	void handle_packet(const std::shared_ptr<connection>& conn, int32_t id, int32_t type, std::string_view body);
+
+	/**
+	 * @brief Creates the responder for a command, which will write its response on the loop that owns `conn`.
 	 *
-	 * @returns bool, true is heartbeat was sent, otherwise false.
+	 * @param received_at When the command was received, so `request_time` can be recorded once it's answered.
 	 */
-	bool send_heartbeat(connected_client& client);
+	command_responder make_responder(const std::shared_ptr<connection>& conn, int32_t id, std::chrono::steady_clock::time_point received_at);
 
-	void client_process_loop(connected_client& client);
+	/**
+	 * @brief Runs the handler for a command that is being answered straight away: its verb's handler in `commands`, `on_command_view`, or `on_command`.
+	 *
+	 * @returns The response, which is blank if nothing handled the command.
+	 */
+	std::string run_command(const command_view& command);
 
-	void add_client(const SOCKET_TYPE client_socket, connected_client& client) {
-		while (!connected_clients_mutex.try_lock()) {
-			std::this_thread::sleep_for(std::chrono::milliseconds(100));
-		}
+	/**
+	 * @brief Hands a command to its verb's handler in `commands`, `on_command_async`, or `on_command_view`/`on_command` and then straight to the responder.
+	 */
+	void dispatch_command(const client_command& command, const command_responder& responder);
 
-		connected_clients.insert({ client_socket, client });
+	/**
+	 * @brief Queues the result of `on_command` to the client that asked for it, split over as many packets as needed.
+	 *
+	 * @param conn The client that sent the command.
+	 * @param id The ID of the command packet, which the response will use.
+	 * @param text_to_send The response.
+	 */
+	void send_response(connection& conn, int32_t id, std::string text_to_send);
 
-		connected_clients_mutex.unlock();
-	}
+	/**
+	 * @brief Marks one of the client's commands as answered, mirroring back any terminators that were waiting on it.
+	 */
+	void finish_response(connection& conn);
 
-	void remove_client(const SOCKET_TYPE client_socket) {
-		while (!connected_clients_mutex.try_lock()) {
-			std::this_thread::sleep_for(std::chrono::milliseconds(100));
-		}
+	/**
+	 * @brief Queues the size, ID, and type of a packet. The body and terminator must be queued straight after.
+	 */
+	void write_packet_header(connection& conn, int32_t id, int32_t type, size_t body_size);
 
-		connected_clients.erase(client_socket);
+	/**
+	 * @brief Encodes a packet straight into the connection's write buffer and queues it. Nothing is sent until `flush` is called.
+	 */
+	void queue_packet(connection& conn, std::string_view body, int32_t id, int32_t type);
 
-		connected_clients_mutex.unlock();
-	};
+	/**
+	 * @brief Copies bytes into the connection's write buffer and queues them.
+	 */
+	void queue_bytes(connection& conn, const char* data, size_t size);
+
+	/**
+	 * @brief Queues bytes already in the connection's write buffer, joining them onto the last segment when they follow straight on.
+	 */
+	void add_segment(connection& conn, size_t offset, size_t size);
+
+	/**
+	 * @brief Queues part of a shared buffer without copying it. The buffer is kept alive until it has been sent.
+	 */
+	void queue_shared(connection& conn, const std::shared_ptr<const std::string>& buffer, size_t offset, size_t size);
+
+	/**
+	 * @brief Queues an encoded broadcast to each of `targets` that `loop` owns, skipping any that are too far behind. Must run on `loop`'s thread.
+	 *
+	 * @param targets The socket and ID of each client to send to. A client is skipped if its socket now belongs to someone else.
+	 */
+	void deliver_broadcast(io_loop& loop, const std::shared_ptr<const std::string>& encoded, size_t packet_count, const std::vector<std::pair<SOCKET_TYPE, uint64_t>>& targets);
+
+	/**
+	 * @brief Sends as much of the write queue as the socket will take.
+	 *
+	 * @returns false if sending failed and the client should be disconnected, otherwise true.
+	 */
+	bool flush(connection& conn);
+
+	/**
+	 * @brief Sends a heartbeat to a client.
+	 *
+	 * @param conn Client to send a heartbeat to.
+	 */
+	void send_heartbeat(connection& conn);
+
+	/**
+	 * @brief Disconnects a client that has missed its login or idle deadline, sends it a heartbeat if it's due one,
+	 * and schedules its timer for whichever of those comes next. Must run on `loop`'s thread.
+	 */
+	void check_timers(io_loop& loop, const std::shared_ptr<connection>& conn);
+
+	/**
+	 * @brief Stops watching and closes a client socket. Must run on `loop`'s thread.
+	 */
+	void close_connection(io_loop& loop, SOCKET_TYPE client_socket, bool remove_after = true);
 };
 
 } // namespace rconpp
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "export.h"
+
+namespace rconpp {
+
+/**
+ * @brief A fixed set of worker threads pulling tasks from a bounded queue.
+ */
+class RCONPP_EXPORT thread_pool {
+	std::vector<std::thread> workers{};
+
+	std::deque<std::function<void()>> tasks{};
+	const size_t max_queued{0};
+
+	std::mutex tasks_mutex;
+	std::condition_variable tasks_ready;
+	bool stopping{false};
+
+	void worker_loop();
+
+public:
+	/**
+	 * @brief thread_pool constructor. Starts the worker threads straight away.
+	 *
+	 * @param threads How many worker threads to start (at least one will always be started).
+	 * @param queue_size How many tasks can be waiting for a worker before `submit` starts refusing them.
+	 * @param pin_threads Should each worker be pinned to its own CPU core? This is only supported on Linux and Windows, and is ignored elsewhere.
+	 */
+	thread_pool(unsigned int threads, size_t queue_size, bool pin_threads = false);
+
+	/**
+	 * @brief Stops the pool. Tasks that are running will finish, tasks still waiting in the queue are dropped.
+	 */
+	~thread_pool();
+
+	/**
+	 * @brief Stops the pool without destroying it, so `submit` can still be called (and refuses everything) while its callers wind down.
+	 * Tasks that are running will finish before this returns, tasks still waiting in the queue are dropped.
+	 *
+	 * @warning Don't call this from one of the pool's own tasks.
+	 */
+	void stop();
+
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator=(const thread_pool&) = delete;
+
+	/**
+	 * @brief Queue a task for a worker to run.
+	 *
+	 * @param task The task to run.
+	 *
+	 * @returns true if the task was queued, false if the queue is full or the pool is stopping.
+	 * This never blocks, so it is safe to call from an event loop.
+	 */
+	bool submit(std::function<void()> task);
+
+	/**
+	 * @returns How many worker threads the pool has.
+	 */
+	size_t size() const {
+		return workers.size();
+	}
+};
+
+} // namespace rconpp
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include "export.h"
+
+namespace rconpp {
+
+/**
+ * @brief A hierarchical timer wheel. Scheduling, moving, and cancelling a timer are all O(1), however many timers there are.
+ *
+ * Time is split into ticks of `resolution`. The first level has a slot for each of the next 64 ticks, and each level after it
+ * covers 64 times as long with slots 64 times as wide. Timers further out sit in a wide slot and are moved down a level when
+ * their slot comes round, so each timer is only touched a handful of times before it fires.
+ *
+ * Timers are owned by whoever schedules them (usually as a member) and call a plain function, so the wheel never allocates.
+ *
+ * @warning A wheel and its timers are not thread safe. Use them from one thread, like the thread running a `reactor`.
+ */
+class RCONPP_EXPORT timer_wheel {
+public:
+	using clock = std::chrono::steady_clock;
+
+	/**
+	 * @brief A single timer. It can be scheduled on one wheel at a time, and is cancelled if it's destroyed while scheduled.
+	 */
+	class RCONPP_EXPORT timer {
+		friend class timer_wheel;
+
+		timer_wheel* wheel{nullptr};
+		timer* previous{nullptr};
+		timer* next{nullptr};
+
+		/**
+		 * @brief The slot the timer is in, and its level.
+		 */
+		timer** bucket{nullptr};
+		size_t level{0};
+
+		/**
+		 * @brief The tick this timer fires on.
+		 */
+		uint64_t expires{0};
+
+	public:
+		/**
+		 * @brief Called on the wheel's thread with `context` when the timer fires.
+		 * The timer has already been taken off the wheel, so it can be scheduled again (or even destroyed) from here.
+		 */
+		void (*callback)(void* context){nullptr};
+		void* context{nullptr};
+
+		timer() = default;
+
+		timer(void (*_callback)(void* context), void* _context) : callback(_callback), context(_context) {}
+
+		~timer();
+
+		timer(const timer&) = delete;
+		timer& operator=(const timer&) = delete;
+
+		/**
+		 * @returns true if the timer is on a wheel, waiting to fire.
+		 */
+		bool scheduled() const {
+			return wheel != nullptr;
+		}
+	};
+
+	static constexpr size_t LEVELS = 4;
+	static constexpr size_t SLOT_BITS = 6;
+	static constexpr size_t SLOTS = 1 << SLOT_BITS;
+
+	/**
+	 * @brief How many ticks ahead a timer can be. Timers further out than this fire early, at the end of the wheel.
+	 */
+	static constexpr uint64_t MAX_TICKS = (uint64_t(1) << (SLOT_BITS * LEVELS)) - 1;
+
+private:
+	/**
+	 * @brief The first timer in each slot. Timers in a slot are linked to each other, so any of them can be taken out without a search.
+	 */
+	std::array<std::array<timer*, SLOTS>, LEVELS> levels{};
+
+	/**
+	 * @brief How many timers are on each level, so empty stretches of the first level can be skipped over.
+	 */
+	std::array<size_t, LEVELS> level_counts{};
+
+	const std::chrono::milliseconds resolution{0};
+	const clock::time_point origin{};
+
+	/**
+	 * @brief The last tick `advance` got to. Every timer fires on a later tick than this.
+	 */
+	uint64_t current{0};
+
+	size_t count{0};
+
+	void link(timer& entry);
+	void unlink(timer& entry);
+
+	/**
+	 * @brief Moves every timer in a slot down to the level (and slot) it now belongs in.
+	 */
+	void cascade(size_t level, size_t index);
+
+	/**
+	 * @returns The first tick at or after `when`.
+	 */
+	uint64_t tick_of(clock::time_point when) const;
+
+	clock::time_point time_of(uint64_t tick) const {
+		return origin + resolution * static_cast<int64_t>(tick);
+	}
+
+public:
+	/**
+	 * @param _resolution How long a tick is. Timers fire up to one tick late, never early.
+	 * @param start When tick 0 is.
+	 */
+	explicit timer_wheel(std::chrono::milliseconds _resolution, clock::time_point start = clock::now());
+
+	~timer_wheel();
+
+	timer_wheel(const timer_wheel&) = delete;
+	timer_wheel& operator=(const timer_wheel&) = delete;
+
+	/**
+	 * @brief Schedule a timer to fire at `when`, moving it if it's already scheduled.
+	 *
+	 * @note A timer due now (or already due) fires on the next tick, never during the call to `advance` that scheduled it.
+	 */
+	void schedule(timer& entry, clock::time_point when);
+
+	/**
+	 * @brief Take a timer off the wheel without firing it. Does nothing if the timer isn't scheduled here.
+	 */
+	void cancel(timer& entry);
+
+	/**
+	 * @brief Fire every timer due by `now`, a tick at a time.
+	 *
+	 * @returns How many timers fired.
+	 */
+	size_t advance(clock::time_point now = clock::now());
+
+	/**
+	 * @returns The soonest the next timer could fire, or `clock::time_point::max()` if there are no timers.
+	 * Timers on the higher levels only give when their slot is next moved down, so this may be earlier than the timer itself (but is never later).
+	 */
+	clock::time_point next_expiry() const;
+
+	/**
+	 * @returns How many timers are scheduled.
+	 */
+	size_t size() const {
+		return count;
+	}
+
+	bool empty() const {
+		return count == 0;
+	}
+};
+
+} // namespace rconpp
@@ -6,6 +6,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #endif
+#include <chrono>
 #include <cstdint>
 
 
@@ -21,7 +22,8 @@ namespace rconpp {
 // Connection constants.
 constexpr int DEFAULT_TIMEOUT = 4; // In Seconds.
 constexpr int MAX_RETRIES_TO_RECEIVE_INFO = 5;
-constexpr int HEARTBEAT_TIME = 30;
+constexpr int REQUEST_TIMEOUT = DEFAULT_TIMEOUT * MAX_RETRIES_TO_RECEIVE_INFO; // In Seconds. How long a request can wait on its response.
+constexpr int HEARTBEAT_TIME = 30; // In Seconds. The default for `rcon_server::heartbeat_interval`.
 constexpr uint8_t MAX_AUTHENTICATION_ATTEMPTS = 3;
 
 // Packet constants.
@@ -29,6 +31,11 @@ constexpr int MIN_PACKET_SIZE = 10;
 constexpr int MIN_PACKET_LENGTH = 14;
 constexpr int MAX_PACKET_SIZE = 4096;
 constexpr int PACKET_SIZE_BYTES = 4; // The first x bytes of the packet to read for the packet size (usually the first 4 bytes)
+constexpr int PACKET_HEADER_LENGTH = PACKET_SIZE_BYTES + 8; // The size, ID, and type of a packet, everything before the body.
+constexpr int32_t INTERNAL_ID_START = 1 << 30; // IDs from here up are used for packets rcon++ sends on its own (and by `send`), so requests shouldn't pick one.
+constexpr int32_t BROADCAST_PACKET_ID = -2; // The ID of packets sent by `rcon_server::broadcast`. Requests can't have negative IDs, so none can clash with it.
+constexpr size_t READ_CHUNK_SIZE = 16384; // How many bytes to ask a socket for at once. Big enough to bring in several packets per read.
+constexpr size_t BUFFER_SLAB_SIZE = READ_CHUNK_SIZE + MAX_PACKET_SIZE; // The size of pooled buffers, a full read on top of a partial packet.
 
 // Used for send/recv calls, as `signal(SIGPIPE, SIG_IGN);` seems to be ignored.
 #ifndef MSG_NOSIGNAL
@@ -106,6 +113,7 @@ enum error_type {
 	DISCONNECTED = 0,
 	BAD_FD = 1,
 	SHUTTING_DOWN = 2,
+	WOULD_BLOCK = 3,
 };
 
 struct last_error {
@@ -124,6 +132,50 @@ struct last_error {
  */
 RCONPP_EXPORT packet form_packet(std::string_view data, int32_t id, int32_t type);
 
+/**
+ * @brief How many bytes a packet takes up once encoded (size, ID, type, body, and both null bytes).
+ *
+ * @param body_size The size of the packet's body.
+ *
+ * @returns The length of the encoded packet.
+ */
+constexpr size_t packet_length(const size_t body_size) {
+	return static_cast<size_t>(PACKET_SIZE_BYTES + MIN_PACKET_SIZE) + body_size;
+}
+
+/**
+ * @brief Write the size, ID, and type of a packet. The body and both null bytes are expected to follow.
+ *
+ * @param destination Where to write the header, this must have room for `PACKET_HEADER_LENGTH` bytes.
+ * @param id The ID of the packet.
+ * @param type The type of packet.
+ * @param body_size The size of the body that will follow.
+ */
+RCONPP_EXPORT void encode_packet_header(char* destination, int32_t id, int32_t type, size_t body_size);
+
+/**
+ * @brief Encode a packet straight into a buffer the caller owns. Unlike `form_packet`, this never allocates.
+ *
+ * @param destination Where to write the packet.
+ * @param capacity How many bytes `destination` has room for.
+ * @param data The data to add to the packet.
+ * @param id The ID of the packet.
+ * @param type The type of packet.
+ *
+ * @returns How many bytes were written (see `packet_length`), or 0 if the packet doesn't fit.
+ */
+RCONPP_EXPORT size_t encode_packet(char* destination, size_t capacity, std::string_view data, int32_t id, int32_t type);
+
+/**
+ * @brief Encode a packet onto the end of `buffer`. A buffer that is reused (and so already big enough) isn't allocated again.
+ *
+ * @param buffer The buffer to add the packet to.
+ * @param data The data to add to the packet.
+ * @param id The ID of the packet.
+ * @param type The type of packet.
+ */
+RCONPP_EXPORT void append_packet(std::vector<char>& buffer, std::string_view data, int32_t id, int32_t type);
+
 /**
  * @brief Turn the first 4 bytes of a buffer (which ideally a 32 bit int) into an integer.
  *
@@ -154,4 +206,32 @@ RCONPP_EXPORT last_error get_last_error();
  */
 RCONPP_EXPORT int read_packet_size(SOCKET_TYPE socket);
 
+/**
+ * @brief Switch a socket between blocking and non-blocking mode.
+ *
+ * @param socket The socket to change.
+ * @param enabled true to make the socket non-blocking, false to make it blocking again.
+ *
+ * @return true if the socket was changed, otherwise false.
+ */
+RCONPP_EXPORT bool set_non_blocking(SOCKET_TYPE socket, bool enabled = true);
+
+/**
+ * @brief Close a socket, using the right call for the platform.
+ *
+ * @param socket The socket to close.
+ */
+RCONPP_EXPORT void close_socket(SOCKET_TYPE socket);
+
+/**
+ * @brief Wait until a socket can be read from (or written to), or a deadline passes.
+ *
+ * @param socket The socket to wait on.
+ * @param for_writing true to wait until the socket can be written to, false to wait until it can be read from.
+ * @param deadline When to give up, on the steady clock.
+ *
+ * @return true if the socket is ready (or has an error waiting to be picked up), false if the deadline passed first.
+ */
+RCONPP_EXPORT bool wait_for_socket(SOCKET_TYPE socket, bool for_writing, std::chrono::steady_clock::time_point deadline);
+
 } // namespace rconpp
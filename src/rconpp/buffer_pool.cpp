@@ -0,0 +1,65 @@
+#include "buffer_pool.h"
+
+rconpp::buffer_pool::buffer_pool(const size_t _slab_size, const size_t _max_pooled) : slab_size(_slab_size), max_pooled(_max_pooled) {
+	free_buffers.reserve(max_pooled);
+}
+
+std::vector<char> rconpp::buffer_pool::acquire() {
+	{
+		std::lock_guard lock(free_mutex);
+
+		if (!free_buffers.empty()) {
+			std::vector<char> buffer = std::move(free_buffers.back());
+			free_buffers.pop_back();
+			hits.fetch_add(1, std::memory_order_relaxed);
+			return buffer;
+		}
+	}
+
+	misses.fetch_add(1, std::memory_order_relaxed);
+
+	std::vector<char> buffer{};
+	buffer.reserve(slab_size);
+	return buffer;
+}
+
+void rconpp::buffer_pool::release(std::vector<char>&& buffer) {
+	if (buffer.capacity() < slab_size) {
+		return;
+	}
+
+	// A buffer that grew for one huge response would sit in the pool holding all that memory, so only ones near a slab are kept.
+	if (buffer.capacity() > slab_size * 4) {
+		discarded.fetch_add(1, std::memory_order_relaxed);
+		std::vector<char>().swap(buffer);
+		return;
+	}
+
+	buffer.clear();
+
+	{
+		std::lock_guard lock(free_mutex);
+
+		if (free_buffers.size() < max_pooled) {
+			free_buffers.emplace_back(std::move(buffer));
+			returned.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+	}
+
+	discarded.fetch_add(1, std::memory_order_relaxed);
+	std::vector<char>().swap(buffer);
+}
+
+rconpp::buffer_pool_stats rconpp::buffer_pool::stats() const {
+	buffer_pool_stats result{};
+	result.hits = hits.load(std::memory_order_relaxed);
+	result.misses = misses.load(std::memory_order_relaxed);
+	result.returned = returned.load(std::memory_order_relaxed);
+	result.discarded = discarded.load(std::memory_order_relaxed);
+
+	std::lock_guard lock(free_mutex);
+	result.pooled = free_buffers.size();
+
+	return result;
+}
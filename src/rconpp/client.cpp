@@ -1,54 +1,254 @@
 #include <mutex>
+#include <algorithm>
+#include <future>
+#include <cstring>
+#include <limits>
 #include "client.h"
 #include "utilities.h"
 
+#ifndef _WIN32
+#include <netinet/tcp.h>
+#endif
+
+namespace {
+
+/**
+ * @brief While anything is waiting on a response, requests are checked on at least this often,
+ * so responses that have gone quiet are noticed even when no deadline is close.
+ */
+constexpr std::chrono::seconds EXPIRY_CHECK_INTERVAL{1};
+
+} // namespace
+
 rconpp::rcon_client::rcon_client(const std::string_view addr, const int _port, const std::string_view pass) : address(addr), port(_port), password(pass) {
 }
 
 rconpp::rcon_client::~rcon_client() {
-	if (on_log) {
-		on_log("RCON client is shutting down.");
-	}
+	log(log_record(LOG_INFO, EVENT_CLIENT_STOPPING));
 
 	// Set connected to false, meaning no requests can be attempted during shutdown.
 	connected = false;
 
 	terminating.notify_all();
 
+	requests_queued.wake();
+
+	// The loop must be done with us before we go, so we're taken off it there and wait for that to happen.
+	// A loop that has stopped will never take us off, but it can't touch us either, so we take ourselves off.
+	if (attached_loop) {
+		if (attached_loop->events.in_loop_thread() || attached_loop->events.stopped()) {
+			detach_from_loop();
+		} else {
+			// Shared with the task, which may still be sitting on a stopped loop after we've gone.
+			auto detached_promise = std::make_shared<std::promise<void>>();
+			std::future<void> detached_future = detached_promise->get_future();
+
+			attached_loop->events.post([this, detached_promise]() {
+				detach_from_loop();
+				detached_promise->set_value();
+			});
+
+			// If we're on another loop's thread, that loop's tasks are kept moving while we wait.
+			// Otherwise two clients destroyed on each other's loops would wait on each other forever.
+			reactor* waiting_loop = reactor::current();
+
+			while (detached_future.wait_for(std::chrono::milliseconds(waiting_loop ? 1 : 50)) != std::future_status::ready) {
+				if (waiting_loop) {
+					waiting_loop->run_tasks();
+				}
+
+				// The loop stopped before it got to our task, so it never will.
+				if (attached_loop->events.stopped()) {
+					if (detached_future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+						detach_from_loop();
+					}
+
+					break;
+				}
+			}
+		}
+	}
+
+	// Wake up the response reader if it's waiting on the server, the socket is closed once nothing is using it.
+	if (sock != INVALID_SOCKET) {
 #ifdef _WIN32
-	closesocket(sock);
-	WSACleanup();
+		shutdown(sock, SD_BOTH);
 #else
-	close(sock);
+		shutdown(sock, SHUT_RDWR);
 #endif
+	}
 
 	// Join the queue runner (if allowed), meaning we await its end before killing this object, preventing any corruption.
 	if (queue_runner.joinable()) {
 		queue_runner.join();
 	}
+
+	if (response_reader.joinable()) {
+		response_reader.join();
+	}
+
+	if (sock != INVALID_SOCKET) {
+		close_socket(sock);
+	}
+
+	// Both threads have stopped, anything they didn't get to is failed here.
+	fail_queued_requests();
+	fail_all_requests();
+
+	if (buffers) {
+		buffers->release(decoder.release_buffer());
+		buffers->release(std::move(send_buffer));
+		buffers->release(std::move(write_buffer));
+	}
+
+#ifdef _WIN32
+	WSACleanup();
+#endif
 }
 
-rconpp::response rconpp::rcon_client::send_data_sync(const std::string_view data, const int32_t id, rconpp::data_type type, bool feedback) {
+rconpp::response rconpp::rcon_client::send_data_sync(const std::string_view data, const int32_t id, rconpp::data_type type, bool feedback, const std::chrono::steady_clock::time_point deadline) {
 	if (!connected && type != data_type::SERVERDATA_AUTH) {
-		on_log("Cannot send data when not connected.");
+		log(log_record(LOG_WARNING, EVENT_NOT_CONNECTED).with_id(id));
+		return { "", false };
+	}
+
+	// Once connected, only the response reader reads from the socket. So we queue the request like anything else, and wait for it.
+	if (connected) {
+		if (!feedback) {
+			send_data(data, id, type);
+			return { "", false };
+		}
+
+		const auto request_deadline = deadline != std::chrono::steady_clock::time_point{} ? deadline : std::chrono::steady_clock::now() + request_timeout;
+
+		std::future<response> future = queue_request(data, id, type, request_deadline);
+
+		// The request is always expired at its deadline, the extra wait is just in case the client has stopped.
+		if (future.wait_until(request_deadline + std::chrono::seconds(DEFAULT_TIMEOUT)) != std::future_status::ready) {
+			return { "", false };
+		}
+
+		return future.get();
+	}
+
+	if (data.size() > MAX_PACKET_SIZE - MIN_PACKET_SIZE) {
+		log(log_record(LOG_WARNING, EVENT_REQUEST_TOO_BIG).with_id(id).with_size(data.size()));
 		return { "", false };
 	}
 
-	packet formed_packet = form_packet(data, id, type);
+	if (id < 0) {
+		log(log_record(LOG_WARNING, EVENT_INVALID_REQUEST_ID).with_id(id));
+		return { "", false };
+	}
+
+	// Only used before `queue_runner` starts, so the two never share `send_buffer` at once.
+	send_buffer.clear();
+	append_packet(send_buffer, data, id, type);
 
-	if (send(sock, formed_packet.data.data(), formed_packet.length, MSG_NOSIGNAL) < 0) {
+	int32_t terminator_id = 0;
+
+	// The terminator goes out in the same send as the command, the server will mirror it back after the full response.
+	if (feedback && type == SERVERDATA_EXECCOMMAND && multi_packet == MULTI_PACKET_TERMINATOR) {
+		terminator_id = allocate_internal_id();
+		append_packet(send_buffer, "", terminator_id, SERVERDATA_RESPONSE_VALUE);
+	}
+
+	if (::send(sock, send_buffer.data(), static_cast<int>(send_buffer.size()), MSG_NOSIGNAL) < 0) {
 		const last_error err = get_last_error();
-		on_log("Sending failed [Error code: " + std::to_string(err.error_code) + "]!");
+		log(log_record(LOG_WARNING, EVENT_SEND_FAILED).with_error(err.error_code));
 		return { "", false };
 	}
 
+	counters.requests_sent.add();
+	counters.packets_out.add(terminator_id != 0 ? 2 : 1);
+	counters.bytes_out.add(send_buffer.size());
+
 	if (!feedback) {
 		// Because we do not want any feedback, we just send no data and say the server didn't respond.
 		return { "", false };
 	}
 
+	const auto sent_at = std::chrono::steady_clock::now();
+
 	// Server will send a SERVERDATA_RESPONSE_VALUE packet.
-	return receive_information(id, type);
+	response result = receive_information(id, type, terminator_id, deadline != std::chrono::steady_clock::time_point{} ? deadline : sent_at + request_timeout);
+
+	if (result.server_responded) {
+		counters.responses_received.add();
+		counters.request_time.record(std::chrono::steady_clock::now() - sent_at);
+	} else {
+		counters.requests_failed.add();
+	}
+
+	return result;
+}
+
+std::future<rconpp::response> rconpp::rcon_client::send(const std::string_view command, const rconpp::data_type type, const std::chrono::steady_clock::time_point deadline) {
+	if (!connected) {
+		std::promise<response> result{};
+		result.set_value({ "", false });
+		return result.get_future();
+	}
+
+	return queue_request(command, allocate_internal_id(), type, deadline);
+}
+
+std::future<std::vector<rconpp::response>> rconpp::rcon_client::send_batch(const std::vector<std::string_view>& commands, const rconpp::data_type type, const std::chrono::steady_clock::time_point deadline) {
+	/**
+	 * @brief Collects every response in the batch, completing the promise when the last one comes in.
+	 */
+	struct batch_state {
+		std::vector<response> responses{};
+		std::atomic<size_t> remaining{0};
+		std::promise<std::vector<response>> result{};
+	};
+
+	auto state = std::make_shared<batch_state>();
+	std::future<std::vector<response>> future = state->result.get_future();
+
+	if (!connected || commands.empty()) {
+		state->result.set_value(std::vector<response>(commands.size()));
+		return future;
+	}
+
+	state->responses.resize(commands.size());
+	state->remaining = commands.size();
+
+	std::vector<queued_request> batch{};
+	batch.reserve(commands.size());
+
+	for (size_t i = 0; i < commands.size(); i++) {
+		// Each callback only writes its own slot, so they don't need a lock between them.
+		batch.push_back(queued_request{ std::string{commands[i]}, allocate_internal_id(), type, [state, i](const response& retrieved_data) {
+			state->responses[i] = retrieved_data;
+
+			if (state->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				state->result.set_value(std::move(state->responses));
+			}
+		}, deadline });
+	}
+
+	requests_in_flight.fetch_add(batch.size(), std::memory_order_relaxed);
+
+	// Queued as one, so they're all picked up (and sent) together.
+	requests_queued.push_all(std::move(batch));
+
+	if (attached_loop) {
+		schedule_drain();
+	}
+
+	return future;
+}
+
+std::future<rconpp::response> rconpp::rcon_client::queue_request(const std::string_view data, const int32_t id, const rconpp::data_type type, const std::chrono::steady_clock::time_point deadline) {
+	auto result = std::make_shared<std::promise<response>>();
+	std::future<response> future = result->get_future();
+
+	send_data(data, id, type, [result](const response& retrieved_data) {
+		result->set_value(retrieved_data);
+	}, deadline);
+
+	return future;
 }
 
 bool rconpp::rcon_client::connect_to_server() {
@@ -57,7 +257,7 @@ bool rconpp::rcon_client::connect_to_server() {
 	WSADATA wsa_data;
 	const int result = WSAStartup(MAKEWORD(2, 2), &wsa_data);
 	if (result != 0) {
-		on_log("WSAStartup failed. Error: " + std::to_string(result));
+		log(log_record(LOG_ERROR, EVENT_STARTUP_FAILED).with_error(result));
 		return false;
 	}
 #endif
@@ -67,7 +267,7 @@ bool rconpp::rcon_client::connect_to_server() {
 
 	if (sock == INVALID_SOCKET) {
 		const last_error err = get_last_error();
-		on_log("Failed to open socket [Error code: " + std::to_string(err.error_code) + "]!");
+		log(log_record(LOG_ERROR, EVENT_SOCKET_FAILED).with_error(err.error_code));
 		return false;
 	}
 
@@ -98,88 +298,682 @@ bool rconpp::rcon_client::connect_to_server() {
 	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
 #endif
 
-	// Connect to the socket and set the status of the connection.
-	int status = connect(sock, (struct sockaddr*)&server, sizeof(server));
+	// Requests are already coalesced into as few writes as possible, so there's nothing for Nagle's algorithm to gain by holding them back.
+	const int no_delay = 1;
+	setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&no_delay), sizeof(no_delay));
+
+	// Connect without blocking, so we can give up once `connect_timeout` has passed rather than whenever the OS does.
+	const auto deadline = std::chrono::steady_clock::now() + connect_timeout;
+
+	set_non_blocking(sock);
+
+	const int status = connect(sock, (struct sockaddr*)&server, sizeof(server));
 
 	if (status == SOCKET_ERROR) {
-		return false;
+		if (get_last_error().type_of_error != WOULD_BLOCK) {
+			return false;
+		}
+
+		if (!wait_for_socket(sock, true, deadline)) {
+			log(log_record(LOG_ERROR, EVENT_CONNECT_TIMED_OUT));
+			return false;
+		}
+
+		int error = 0;
+		socklen_t error_size = sizeof(error);
+		getsockopt(sock, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &error_size);
+
+		if (error != 0) {
+			return false;
+		}
 	}
 
+	set_non_blocking(sock, false);
+
 	return true;
 }
 
-rconpp::response rconpp::rcon_client::receive_information(int32_t id, rconpp::data_type type) {
-	// Whilst this loop is better than a while loop,
-	// it should really just keep going for a certain amount of seconds.
-	for (int i = 0; i < MAX_RETRIES_TO_RECEIVE_INFO; i++) {
-		packet packet_response = read_packet();
+rconpp::response rconpp::rcon_client::receive_information(const int32_t id, const rconpp::data_type type, const int32_t terminator_id, const std::chrono::steady_clock::time_point deadline) {
+	assembly_buffer.clear();
+	assembly_buffer.reserve(response_reserve);
+
+	bool received_part = false;
+	bool accepted = false;
+
+	// Every read gives up at the deadline, however many packets (or partial packets) the response takes.
+	while (true) {
+		// We already have some of the response, if the server goes quiet that will have to be all of it.
+		const auto read_until = received_part ? std::min(deadline, std::chrono::steady_clock::now() + std::chrono::seconds(DEFAULT_TIMEOUT)) : deadline;
+
+		decoded_packet packet{};
+
+		if (read_packet(packet, read_until) != READ_OK) {
+			break;
+		}
+
+		if (type == SERVERDATA_AUTH) {
+			// Source servers send an empty SERVERDATA_RESPONSE_VALUE before the real answer, which we don't care about.
+			if (packet.type != SERVERDATA_AUTH_RESPONSE) {
+				continue;
+			}
+
+			received_part = true;
+			accepted = packet.id == id;
+			break;
+		}
+
+		if (packet.id == id) {
+			assembly_buffer.append(packet.body);
+			received_part = true;
+
+			if (multi_packet == MULTI_PACKET_NONE || (multi_packet == MULTI_PACKET_SIZE && packet.body.size() < full_packet_body_size)) {
+				break;
+			}
+
+			// Without a terminator on the way, MULTI_PACKET_TERMINATOR can't tell when to stop.
+			if (multi_packet == MULTI_PACKET_TERMINATOR && terminator_id == 0) {
+				break;
+			}
 
-		if (packet_response.length == -1) {
 			continue;
 		}
 
-		const auto packet_type = static_cast<data_type>(bit32_to_int(packet_response.data));
+		if (terminator_id != 0 && packet.id == terminator_id) {
+			received_part = true;
+			break;
+		}
+	}
+
+	if (!received_part) {
+		log(log_record(LOG_WARNING, EVENT_RESPONSE_TIMED_OUT).with_id(id));
+		return { "", false };
+	}
+
+	if (type == SERVERDATA_AUTH) {
+		return { "", accepted };
+	}
+
+	return { assembly_buffer, true };
+}
+
+rconpp::rcon_client::read_result rconpp::rcon_client::read_packet(decoded_packet& packet, const std::chrono::steady_clock::time_point deadline) {
+	int timeouts = 0;
+
+	while (true) {
+		const decode_result result = decoder.next(packet, max_packet_size);
+
+		if (result == DECODE_PACKET) {
+			counters.packets_in.add();
+			return READ_OK;
+		}
+
+		if (result == DECODE_INVALID) {
+			log(log_record(LOG_WARNING, EVENT_INVALID_PACKET_SIZE));
+			return READ_FAILED;
+		}
+
+		if (deadline != std::chrono::steady_clock::time_point{} && !wait_for_socket(sock, false, deadline)) {
+			return decoder.buffered() == 0 ? READ_TIMED_OUT : READ_FAILED;
+		}
+
+		// One read usually brings in every packet the server has sent so far, the calls after it don't touch the socket.
+		const auto received = recv(sock, decoder.prepare(READ_CHUNK_SIZE), static_cast<int>(READ_CHUNK_SIZE), MSG_NOSIGNAL);
 
-		if (packet_response.length == 0) {
-			if (packet_type != SERVERDATA_AUTH) {
-				return { "", packet_response.server_responded };
+		if (received == 0) {
+			return READ_FAILED;
+		}
+
+		if (received < 0) {
+			if (get_last_error().type_of_error != WOULD_BLOCK) {
+				return READ_FAILED;
+			}
+
+			// Nothing has arrived yet, let the caller decide what to do about that.
+			if (decoder.buffered() == 0) {
+				return READ_TIMED_OUT;
+			}
+
+			// We're part way through a packet, the rest should be on its way.
+			if (++timeouts >= MAX_RETRIES_TO_RECEIVE_INFO) {
+				return READ_FAILED;
 			}
 
 			continue;
 		}
 
-		if (type == SERVERDATA_AUTH) {
-			return { "", packet_type == id };
+		decoder.commit(static_cast<size_t>(received));
+		counters.bytes_in.add(static_cast<uint64_t>(received));
+	}
+}
+
+std::chrono::steady_clock::time_point rconpp::rcon_client::encode_requests(std::vector<queued_request>& batch, std::vector<char>& buffer) {
+	std::vector<std::function<void(const response& response)>> rejected{};
+	auto next_check = std::chrono::steady_clock::time_point::max();
+
+	const auto now = std::chrono::steady_clock::now();
+
+	{
+		std::lock_guard lock(pending_mutex);
+
+		/*
+		 * The response reader fails every pending request after setting `connected` to false, under this lock.
+		 * Checking here means a batch is either seen by it, or failed by us. It can't slip between the two.
+		 */
+		if (!connected) {
+			requests_in_flight.fetch_sub(batch.size(), std::memory_order_relaxed);
+			counters.requests_failed.add(batch.size());
+
+			for (queued_request& request : batch) {
+				if (request.callback) {
+					rejected.emplace_back(std::move(request.callback));
+				}
+			}
+
+			batch.clear();
+		}
+
+		for (queued_request& request : batch) {
+			int32_t terminator_id = 0;
+
+			if (request.data.size() > MAX_PACKET_SIZE - MIN_PACKET_SIZE) {
+				log(log_record(LOG_WARNING, EVENT_REQUEST_TOO_BIG).with_id(request.id).with_size(request.data.size()));
+
+				if (request.callback) {
+					rejected.emplace_back(std::move(request.callback));
+				}
+
+				requests_in_flight.fetch_sub(1, std::memory_order_relaxed);
+				counters.requests_failed.add();
+				continue;
+			}
+
+			// Negative IDs are the server's (-1 for a failed login, `BROADCAST_PACKET_ID` for broadcasts), so a response to one would never find its request.
+			if (request.id < 0) {
+				log(log_record(LOG_WARNING, EVENT_INVALID_REQUEST_ID).with_id(request.id));
+
+				if (request.callback) {
+					rejected.emplace_back(std::move(request.callback));
+				}
+
+				requests_in_flight.fetch_sub(1, std::memory_order_relaxed);
+				counters.requests_failed.add();
+				continue;
+			}
+
+			// Requests are remembered before they are sent, so the response can't beat us to it.
+			if (request.callback) {
+				if (pending_requests.find(request.id) != pending_requests.end()) {
+					log(log_record(LOG_WARNING, EVENT_DUPLICATE_REQUEST_ID).with_id(request.id));
+					rejected.emplace_back(std::move(request.callback));
+					requests_in_flight.fetch_sub(1, std::memory_order_relaxed);
+					counters.requests_failed.add();
+					continue;
+				}
+
+				pending_request pending{};
+				pending.callback = std::move(request.callback);
+				pending.deadline = request.deadline != std::chrono::steady_clock::time_point{} ? request.deadline : now + request_timeout;
+				pending.sent_at = now;
+
+				next_check = std::min({ next_check, pending.deadline, now + EXPIRY_CHECK_INTERVAL });
+
+				if (request.type == SERVERDATA_EXECCOMMAND && multi_packet == MULTI_PACKET_TERMINATOR) {
+					terminator_id = allocate_internal_id();
+					pending.terminator_id = terminator_id;
+					pending_terminators.emplace(terminator_id, request.id);
+				}
+
+				pending_requests.emplace(request.id, std::move(pending));
+			} else {
+				// Nothing will come back for this one, so it's done as soon as it's sent.
+				requests_in_flight.fetch_sub(1, std::memory_order_relaxed);
+			}
+
+			append_packet(buffer, request.data, request.id, request.type);
+			counters.requests_sent.add();
+			counters.packets_out.add();
+
+			if (terminator_id != 0) {
+				append_packet(buffer, "", terminator_id, SERVERDATA_RESPONSE_VALUE);
+				counters.packets_out.add();
+			}
+		}
+	}
+
+	for (const auto& callback : rejected) {
+		callback({ "", false });
+	}
+
+	return next_check;
+}
+
+std::chrono::steady_clock::time_point rconpp::rcon_client::send_requests(std::vector<queued_request>& batch) {
+	std::vector<char>& buffer = send_buffer;
+	buffer.clear();
+
+	const auto next_check = encode_requests(batch, buffer);
+
+	// Every request in the batch goes out together, none of them wait for a response before the next is sent.
+	size_t sent_total = 0;
+
+	while (sent_total < buffer.size()) {
+		const auto sent = ::send(sock, buffer.data() + sent_total, static_cast<int>(buffer.size() - sent_total), MSG_NOSIGNAL);
+
+		if (sent < 0) {
+			const last_error err = get_last_error();
+			log(log_record(LOG_WARNING, EVENT_SEND_FAILED).with_error(err.error_code));
+
+			/*
+			 * Part of the batch may have gone out, so the server can't make sense of anything we send after it.
+			 * Like a failed read, we disconnect and fail everything waiting on a response.
+			 */
+			if (connected) {
+				log(log_record(LOG_WARNING, EVENT_CONNECTION_LOST));
+			}
+
+			connected = false;
+
+			// Wake up the response reader, which will see we've disconnected.
+#ifdef _WIN32
+			shutdown(sock, SD_BOTH);
+#else
+			shutdown(sock, SHUT_RDWR);
+#endif
+
+			fail_all_requests();
+			return next_check;
 		}
 
-		if (packet_type == id) {
-			std::string part{};
+		sent_total += static_cast<size_t>(sent);
+		counters.bytes_out.add(static_cast<uint64_t>(sent));
+	}
+
+	return next_check;
+}
+
+void rconpp::rcon_client::read_responses() {
+	while (connected) {
+		decoded_packet packet{};
+
+		const read_result result = read_packet(packet, {});
 
-			if (packet_response.size > MIN_PACKET_SIZE) {
-				part = std::string(&packet_response.data[8], &packet_response.data[packet_response.data.size()-1]);
+		if (result == READ_FAILED) {
+			if (connected) {
+				log(log_record(LOG_WARNING, EVENT_CONNECTION_LOST));
 			}
 
-			return { part, packet_response.server_responded };
+			connected = false;
+
+			// The queue runner may be asleep waiting for requests, it needs to see we've disconnected.
+			requests_queued.wake();
+			break;
+		}
+
+		if (result == READ_OK) {
+			deliver_packet(packet);
 		}
 	}
 
-	on_log("Did not receive a packet in time. Did the server send a response?");
-	return { "", false };
+	fail_all_requests();
 }
 
-rconpp::packet rconpp::rcon_client::read_packet() {
-	const int packet_size = read_packet_size(static_cast<int>(sock));
+bool rconpp::rcon_client::response_finished(const pending_request& request, const size_t body_size) const {
+	return multi_packet == MULTI_PACKET_NONE || (multi_packet == MULTI_PACKET_SIZE && body_size < full_packet_body_size) || request.terminator_id == 0;
+}
+
+void rconpp::rcon_client::deliver_packet(const decoded_packet& packet) {
+	// Broadcasts aren't answering anything, so there's no request to look for.
+	if (packet.id == BROADCAST_PACKET_ID) {
+		if (on_broadcast) {
+			on_broadcast(packet.body);
+		}
 
-	if (packet_size == -1) {
-		return {};
+		return;
 	}
 
-	packet temp_packet{};
-	temp_packet.length = packet_size + PACKET_SIZE_BYTES;
+	bool finished = false;
+	int32_t finished_id = 0;
+
+	{
+		std::lock_guard lock(pending_mutex);
+
+		if (auto found = pending_requests.find(packet.id); found != pending_requests.end()) {
+			pending_request& request = found->second;
+
+			// A full packet usually means more are coming, so make room for them all in one go.
+			if (request.data.empty() && packet.body.size() >= full_packet_body_size) {
+				request.data.reserve(response_reserve);
+			}
+
+			request.data.append(packet.body);
+			request.received_part = true;
+			request.last_received_at = std::chrono::steady_clock::now();
 
-	if (packet_size > 0) {
-		temp_packet.size = packet_size;
+			finished = response_finished(request, packet.body.size());
+			finished_id = packet.id;
+		} else if (auto terminator = pending_terminators.find(packet.id); terminator != pending_terminators.end()) {
+			finished = true;
+			finished_id = terminator->second;
+		}
+	}
+
+	// Anything else isn't for something we're waiting on (like a heartbeat, or a late response), so it's thrown away.
+	if (finished) {
+		complete_request(finished_id, true);
 	}
+}
+
+void rconpp::rcon_client::complete_request(const int32_t id, const bool server_responded) {
+	pending_request request{};
 
-	temp_packet.server_responded = true;
+	{
+		std::lock_guard lock(pending_mutex);
 
-	// If the packet size is 0, the server did respond but said nothing.
-	if (packet_size == 0) {
-		return temp_packet;
+		auto found = pending_requests.find(id);
+
+		if (found == pending_requests.end()) {
+			return;
+		}
+
+		request = std::move(found->second);
+		pending_requests.erase(found);
+		requests_in_flight.fetch_sub(1, std::memory_order_relaxed);
+
+		if (request.terminator_id != 0) {
+			pending_terminators.erase(request.terminator_id);
+		}
 	}
 
-	std::vector<char> buffer{};
-	buffer.resize(temp_packet.length);
+	if (server_responded || request.received_part) {
+		counters.responses_received.add();
+		counters.request_time.record(std::chrono::steady_clock::now() - request.sent_at);
+	} else {
+		counters.requests_failed.add();
+	}
 
-	/*
-	 * Receiving by the length of the packet will give us 4 extra bytes, so, we do by size here.
-	 * This is because read_packet_size() reads the first 4 bytes and discards them.
-	 */
-	recv(sock, buffer.data(), temp_packet.size, MSG_NOSIGNAL);
+	if (request.callback) {
+		request.callback({ std::move(request.data), server_responded || request.received_part });
+	}
+}
+
+std::chrono::steady_clock::time_point rconpp::rcon_client::expire_requests() {
+	const auto now = std::chrono::steady_clock::now();
+	auto next_check = std::chrono::steady_clock::time_point::max();
+
+	std::vector<int32_t> expired{};
 
-	temp_packet.data = buffer;
+	{
+		std::lock_guard lock(pending_mutex);
 
-	return temp_packet;
+		for (const auto& [id, request] : pending_requests) {
+			// A response that has started but gone quiet is as complete as it's going to get.
+			const auto expires_at = request.received_part ? std::min(request.deadline, request.last_received_at + std::chrono::seconds(DEFAULT_TIMEOUT)) : request.deadline;
+
+			if (now >= expires_at) {
+				expired.push_back(id);
+			} else {
+				next_check = std::min(next_check, expires_at);
+			}
+		}
+
+		if (pending_requests.size() > expired.size()) {
+			next_check = std::min(next_check, now + EXPIRY_CHECK_INTERVAL);
+		}
+	}
+
+	for (const int32_t id : expired) {
+		complete_request(id, false);
+	}
+
+	return next_check;
+}
+
+void rconpp::rcon_client::fail_queued_requests() {
+	queued_request request{};
+
+	while (requests_queued.try_pop(request)) {
+		requests_in_flight.fetch_sub(1, std::memory_order_relaxed);
+		counters.requests_failed.add();
+
+		if (request.callback) {
+			request.callback({ "", false });
+		}
+	}
+}
+
+void rconpp::rcon_client::fail_all_requests() {
+	std::vector<int32_t> remaining{};
+
+	{
+		std::lock_guard lock(pending_mutex);
+
+		for (const auto& [id, request] : pending_requests) {
+			remaining.push_back(id);
+		}
+	}
+
+	for (const int32_t id : remaining) {
+		complete_request(id, false);
+	}
+}
+
+void rconpp::rcon_client::attach(rcon_io_context& context) {
+	if (connected || attached_loop) {
+		log(log_record(LOG_WARNING, EVENT_ALREADY_ATTACHED));
+		return;
+	}
+
+	attached_loop = &context.pick_loop();
+
+	if (!buffers) {
+		buffers = context.buffers;
+	}
+}
+
+void rconpp::rcon_client::schedule_drain() {
+	// One drain waiting on the loop is enough, it sends everything queued by the time it runs.
+	if (!drain_scheduled.exchange(true)) {
+		attached_loop->events.post([this]() {
+			drain_requests();
+		});
+	}
+}
+
+void rconpp::rcon_client::register_with_loop() {
+	if (!connected || detached) {
+		return;
+	}
+
+	set_non_blocking(sock);
+
+	if (!attached_loop->events.add(sock, IO_READABLE, [this](const uint32_t events) { on_socket_event(events); })) {
+		lose_connection();
+		return;
+	}
+
+	attached_loop->clients.insert(this);
+	registered = true;
+
+	// Anything queued before we were connected can go out now.
+	drain_requests();
+}
+
+void rconpp::rcon_client::drain_requests() {
+	drain_scheduled = false;
+
+	if (detached) {
+		fail_queued_requests();
+		return;
+	}
+
+	if (!registered) {
+		return;
+	}
+
+	queued_request request{};
+
+	while (requests_queued.try_pop(request)) {
+		drain_batch.emplace_back(std::move(request));
+	}
+
+	if (drain_batch.empty()) {
+		return;
+	}
+
+	attached_loop->events.tick_before(encode_requests(drain_batch, write_buffer));
+	drain_batch.clear();
+
+	if (!flush_writes()) {
+		lose_connection();
+	}
+}
+
+bool rconpp::rcon_client::flush_writes() {
+	while (write_offset < write_buffer.size()) {
+		const auto sent = ::send(sock, write_buffer.data() + write_offset, static_cast<int>(write_buffer.size() - write_offset), MSG_NOSIGNAL);
+
+		if (sent < 0) {
+			const last_error err = get_last_error();
+
+			// The socket is full, we'll be told when there's room for the rest.
+			if (err.type_of_error == WOULD_BLOCK) {
+				attached_loop->events.modify(sock, IO_READABLE | IO_WRITABLE);
+				return true;
+			}
+
+			log(log_record(LOG_WARNING, EVENT_SEND_FAILED).with_error(err.error_code));
+			return false;
+		}
+
+		write_offset += static_cast<size_t>(sent);
+		counters.bytes_out.add(static_cast<uint64_t>(sent));
+	}
+
+	// The buffer keeps its capacity, so a busy client isn't allocating a new one every time.
+	write_buffer.clear();
+	write_offset = 0;
+
+	attached_loop->events.modify(sock, IO_READABLE);
+	return true;
+}
+
+void rconpp::rcon_client::on_socket_event(const uint32_t events) {
+	if ((events & IO_WRITABLE) && !flush_writes()) {
+		lose_connection();
+		return;
+	}
+
+	if (!(events & (IO_READABLE | IO_CLOSED))) {
+		return;
+	}
+
+	// Drain the socket, we will not be told about this data again.
+	while (true) {
+		const auto received = recv(sock, decoder.prepare(READ_CHUNK_SIZE), static_cast<int>(READ_CHUNK_SIZE), MSG_NOSIGNAL);
+
+		if (received > 0) {
+			decoder.commit(static_cast<size_t>(received));
+			counters.bytes_in.add(static_cast<uint64_t>(received));
+
+			// Handled before the next read, so the decoder only ever holds part of a packet between reads.
+			if (!parse_responses()) {
+				lose_connection();
+				return;
+			}
+
+			continue;
+		}
+
+		if (received == 0 || get_last_error().type_of_error != WOULD_BLOCK) {
+			lose_connection();
+		}
+
+		return;
+	}
+}
+
+bool rconpp::rcon_client::parse_responses() {
+	decoded_packet packet{};
+	decode_result result{DECODE_NEED_MORE};
+
+	while ((result = decoder.next(packet, max_packet_size)) == DECODE_PACKET) {
+		counters.packets_in.add();
+		deliver_packet(packet);
+	}
+
+	if (result == DECODE_INVALID) {
+		log(log_record(LOG_WARNING, EVENT_INVALID_PACKET_SIZE));
+		return false;
+	}
+
+	return true;
+}
+
+void rconpp::rcon_client::lose_connection() {
+	if (connected) {
+		log(log_record(LOG_WARNING, EVENT_CONNECTION_LOST));
+	}
+
+	connected = false;
+
+	detach_from_loop();
+
+	fail_all_requests();
+	fail_queued_requests();
+}
+
+void rconpp::rcon_client::detach_from_loop() {
+	if (registered) {
+		attached_loop->events.remove(sock);
+		attached_loop->clients.erase(this);
+		registered = false;
+	}
+
+	detached = true;
+}
+
+rconpp::client_metrics rconpp::rcon_client::metrics() const {
+	client_metrics result{};
+
+	result.requests_sent = counters.requests_sent.load();
+	result.responses_received = counters.responses_received.load();
+	result.requests_failed = counters.requests_failed.load();
+	result.packets_in = counters.packets_in.load();
+	result.packets_out = counters.packets_out.load();
+	result.bytes_in = counters.bytes_in.load();
+	result.bytes_out = counters.bytes_out.load();
+	result.request_time = counters.request_time.snapshot();
+
+	return result;
+}
+
+std::string rconpp::client_metrics::to_text() const {
+	metrics_writer writer{};
+
+	writer.counter("rconpp_client_requests_sent", "Requests sent to the server.", requests_sent);
+	writer.counter("rconpp_client_responses_received", "Requests the server answered.", responses_received);
+	writer.counter("rconpp_client_requests_failed", "Requests that were never sent, or never answered.", requests_failed);
+	writer.counter("rconpp_client_packets_in", "Packets received from the server.", packets_in);
+	writer.counter("rconpp_client_packets_out", "Packets sent to the server.", packets_out);
+	writer.counter("rconpp_client_bytes_in", "Bytes received from the server.", bytes_in);
+	writer.counter("rconpp_client_bytes_out", "Bytes sent to the server.", bytes_out);
+
+	writer.histogram("rconpp_client_request_seconds", "How long requests took from being sent to being answered.", "", request_time);
+
+	return writer.str();
+}
+
+int32_t rconpp::rcon_client::allocate_internal_id() {
+	int32_t id = next_internal_id.load(std::memory_order_relaxed);
+	int32_t following = 0;
+
+	// The counter is only ever swapped for the ID after the one we took, so no two threads are given the same ID, even as it wraps.
+	do {
+		// Wrap back around before we run into negative IDs.
+		following = id == std::numeric_limits<int32_t>::max() ? INTERNAL_ID_START : id + 1;
+	} while (!next_internal_id.compare_exchange_weak(id, following, std::memory_order_relaxed));
+
+	return id;
 }
 
 void rconpp::rcon_client::start(const bool return_after) {
@@ -190,53 +984,94 @@ void rconpp::rcon_client::start(const bool return_after) {
 	};
 
 	if (address.empty()) {
-		on_log("Address is empty! You need to pass a valid address!");
+		log(log_record(LOG_ERROR, EVENT_INVALID_ADDRESS));
 		return;
 	}
 
 	if (port > 65535) {
-		on_log("Invalid port! The port can't exceed 65535!");
+		log(log_record(LOG_ERROR, EVENT_INVALID_PORT));
 		return;
 	}
 
-	on_log("Attempting connection to RCON server...");
+	if (buffers) {
+		decoder.use_buffer(buffers->acquire());
+		send_buffer = buffers->acquire();
+
+		if (attached_loop) {
+			write_buffer = buffers->acquire();
+		}
+	}
+
+	log(log_record(LOG_INFO, EVENT_CONNECTING));
 
 	if (!connect_to_server()) {
-		on_log("RCON++ is aborting as it failed to connect to the RCON server. Double check the IP and port.");
+		log(log_record(LOG_ERROR, EVENT_CONNECT_FAILED));
 		return;
 	}
 
-	on_log("Connected successfully! Sending login data...");
+	log(log_record(LOG_INFO, EVENT_LOGGING_IN));
 
 	// The server will send SERVERDATA_AUTH_RESPONSE once it's happy. If it's not -1, the server will have accepted us!
 	// We use the _sync method here to do a blocking call.
 	const response response = send_data_sync(password, 1, SERVERDATA_AUTH, true);
 
 	if (!response.server_responded) {
-		on_log("Login data was incorrect. RCON++ will now abort.");
+		log(log_record(LOG_ERROR, EVENT_LOGIN_FAILED));
 		return;
 	}
 
-	on_log("Login Data sent successfully, we have been accepted!");
+	log(log_record(LOG_INFO, EVENT_LOGGED_IN));
 
 	connected = true;
 
+	// Attached clients have their socket watched by the context's loop, instead of threads of their own.
+	if (attached_loop) {
+		attached_loop->events.post([this]() {
+			register_with_loop();
+		});
+
+		if (!return_after) {
+			block_calling_thread();
+		}
+
+		return;
+	}
+
+	response_reader = std::thread(&rcon_client::read_responses, this);
+
 	queue_runner = std::thread([this]() {
+		// Kept between batches, so a busy client isn't allocating a new one every time.
+		std::vector<queued_request> batch{};
+		queued_request request{};
+
+		// This thread also fails requests that pass their deadline, so it wakes up for the next one even when nothing is queued.
+		auto next_expiry = std::chrono::steady_clock::time_point::max();
+
 		while (connected) {
-			if (requests_queued.empty()) {
-				continue;
+			if (std::chrono::steady_clock::now() >= next_expiry) {
+				next_expiry = expire_requests();
 			}
 
-			for (const queued_request& request : requests_queued) {
-				// Send data to callback if it's been set.
-				if (request.callback)
-					request.callback(send_data_sync(request.data, request.id, request.type));
-				else
-					send_data_sync(request.data, request.id, request.type, false);
+			while (requests_queued.try_pop(request)) {
+				batch.emplace_back(std::move(request));
 			}
 
-			requests_queued.clear();
+			// Nothing to send, sleep until something is queued, a request needs expiring, or we're shutting down.
+			if (batch.empty()) {
+				if (next_expiry == std::chrono::steady_clock::time_point::max()) {
+					requests_queued.wait();
+				} else {
+					requests_queued.wait_until(next_expiry);
+				}
+
+				continue;
+			}
+
+			next_expiry = std::min(next_expiry, send_requests(batch));
+			batch.clear();
 		}
+
+		fail_queued_requests();
 	});
 
 	if (!return_after) {
@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <limits>
+#include "client_pool.h"
+
+rconpp::rcon_client_pool::rcon_client_pool(const std::string_view addr, const int _port, const std::string_view pass, const size_t size)
+	: address(addr), port(_port), password(pass), pool_size(std::max<size_t>(1, size)) {
+}
+
+rconpp::rcon_client_pool::~rcon_client_pool() {
+	{
+		std::lock_guard lock(maintainer_mutex);
+		stopping = true;
+	}
+
+	maintainer_wake.notify_all();
+
+	if (maintainer.joinable()) {
+		maintainer.join();
+	}
+
+	std::unique_lock lock(clients_mutex);
+	clients.clear();
+}
+
+std::unique_ptr<rconpp::rcon_client> rconpp::rcon_client_pool::make_client() {
+	auto client = std::make_unique<rcon_client>(address, port, password);
+	client->buffers = buffers;
+
+	// Only hooked up when the pool has somewhere to send them, so clients don't format lines nobody reads.
+	if (on_log) {
+		client->on_log = [this](const std::string_view& log) {
+			on_log(log);
+		};
+	}
+
+	if (on_log_record) {
+		client->on_log_record = [this](const log_record& record) {
+			on_log_record(record);
+		};
+	}
+
+	if (setup_client) {
+		setup_client(*client);
+	}
+
+	client->start(true);
+
+	return client;
+}
+
+bool rconpp::rcon_client_pool::start() {
+	std::vector<std::unique_ptr<rcon_client>> started(pool_size);
+
+	{
+		// Each connection waits on the server, so they're all made at once rather than one after another.
+		std::vector<std::thread> connectors{};
+		connectors.reserve(pool_size);
+
+		for (size_t i = 0; i < pool_size; i++) {
+			connectors.emplace_back([this, &started, i]() {
+				started[i] = make_client();
+			});
+		}
+
+		for (auto& connector : connectors) {
+			connector.join();
+		}
+	}
+
+	{
+		std::unique_lock lock(clients_mutex);
+		clients = std::move(started);
+	}
+
+	const size_t connected = connected_count();
+
+	log(log_record(LOG_INFO, EVENT_POOL_STARTED).with_size(connected).with_id(static_cast<int32_t>(pool_size)));
+
+	maintainer = std::thread(&rcon_client_pool::maintain, this);
+
+	return connected > 0;
+}
+
+rconpp::rcon_client* rconpp::rcon_client_pool::pick_client() const {
+	rcon_client* best = nullptr;
+	size_t best_load = std::numeric_limits<size_t>::max();
+
+	const size_t start_at = next_client.fetch_add(1, std::memory_order_relaxed);
+
+	for (size_t i = 0; i < clients.size(); i++) {
+		rcon_client* client = clients[(start_at + i) % clients.size()].get();
+
+		if (!client || !client->connected) {
+			continue;
+		}
+
+		const size_t load = client->in_flight();
+
+		if (load < best_load) {
+			best = client;
+			best_load = load;
+
+			// Nothing beats an idle client.
+			if (load == 0) {
+				break;
+			}
+		}
+	}
+
+	return best;
+}
+
+void rconpp::rcon_client_pool::send_data(const std::string_view data, const int32_t id, const rconpp::data_type type, std::function<void(const response& retrieved_data)> callback, const std::chrono::steady_clock::time_point deadline) {
+	{
+		std::shared_lock lock(clients_mutex);
+
+		if (rcon_client* client = pick_client()) {
+			client->send_data(data, id, type, std::move(callback), deadline);
+			return;
+		}
+	}
+
+	request_maintenance();
+
+	log(log_record(LOG_WARNING, EVENT_POOL_NOT_CONNECTED).with_id(id));
+
+	if (callback) {
+		callback({ "", false });
+	}
+}
+
+rconpp::response rconpp::rcon_client_pool::send_data_sync(const std::string_view data, const int32_t id, const rconpp::data_type type, const bool feedback, const std::chrono::steady_clock::time_point deadline) {
+	if (!feedback) {
+		send_data(data, id, type);
+		return { "", false };
+	}
+
+	auto result = std::make_shared<std::promise<response>>();
+	std::future<response> future = result->get_future();
+
+	// The client's own `request_timeout` is used if there's no deadline, so ours is only a backstop.
+	const auto wait_deadline = deadline != std::chrono::steady_clock::time_point{} ? deadline : std::chrono::steady_clock::now() + std::chrono::seconds(REQUEST_TIMEOUT);
+
+	send_data(data, id, type, [result](const response& retrieved_data) {
+		result->set_value(retrieved_data);
+	}, deadline);
+
+	// The client will always expire the request, this is just in case it has stopped.
+	if (future.wait_until(wait_deadline + std::chrono::seconds(DEFAULT_TIMEOUT)) != std::future_status::ready) {
+		return { "", false };
+	}
+
+	return future.get();
+}
+
+std::future<rconpp::response> rconpp::rcon_client_pool::send(const std::string_view command, const rconpp::data_type type, const std::chrono::steady_clock::time_point deadline) {
+	{
+		std::shared_lock lock(clients_mutex);
+
+		if (rcon_client* client = pick_client()) {
+			return client->send(command, type, deadline);
+		}
+	}
+
+	request_maintenance();
+
+	std::promise<response> result{};
+	result.set_value({ "", false });
+	return result.get_future();
+}
+
+std::future<std::vector<rconpp::response>> rconpp::rcon_client_pool::send_batch(const std::vector<std::string_view>& commands, const rconpp::data_type type, const std::chrono::steady_clock::time_point deadline) {
+	{
+		std::shared_lock lock(clients_mutex);
+
+		if (rcon_client* client = pick_client()) {
+			return client->send_batch(commands, type, deadline);
+		}
+	}
+
+	request_maintenance();
+
+	std::promise<std::vector<response>> result{};
+	result.set_value(std::vector<response>(commands.size()));
+	return result.get_future();
+}
+
+size_t rconpp::rcon_client_pool::connected_count() const {
+	std::shared_lock lock(clients_mutex);
+
+	return static_cast<size_t>(std::count_if(clients.begin(), clients.end(), [](const std::unique_ptr<rcon_client>& client) {
+		return client && client->connected;
+	}));
+}
+
+void rconpp::rcon_client_pool::request_maintenance() {
+	{
+		std::lock_guard lock(maintainer_mutex);
+		maintenance_requested = true;
+	}
+
+	maintainer_wake.notify_one();
+}
+
+void rconpp::rcon_client_pool::maintain() {
+	while (true) {
+		{
+			std::unique_lock lock(maintainer_mutex);
+			maintainer_wake.wait_for(lock, maintenance_interval, [this]() { return stopping || maintenance_requested; });
+
+			if (stopping) {
+				return;
+			}
+
+			maintenance_requested = false;
+		}
+
+		std::vector<size_t> dead{};
+
+		{
+			std::shared_lock lock(clients_mutex);
+
+			for (size_t i = 0; i < clients.size(); i++) {
+				if (!clients[i] || !clients[i]->connected) {
+					dead.push_back(i);
+				}
+			}
+		}
+
+		for (const size_t index : dead) {
+			// Connecting can take up to `connect_timeout` and `request_timeout`, so the pool's destructor isn't kept waiting on connections it no longer wants.
+			if (stopping) {
+				return;
+			}
+
+			// Connecting blocks, so it's done without holding the lock. Senders keep using the clients that are still alive.
+			std::unique_ptr<rcon_client> replacement = make_client();
+
+			if (stopping) {
+				return;
+			}
+
+			if (!replacement->connected) {
+				continue;
+			}
+
+			{
+				std::unique_lock lock(clients_mutex);
+				clients[index].swap(replacement);
+			}
+
+			log(log_record(LOG_INFO, EVENT_POOL_CLIENT_REPLACED));
+
+			// `replacement` now holds the dead client, which is destroyed here (failing anything it still had pending).
+		}
+	}
+}
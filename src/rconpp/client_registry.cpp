@@ -0,0 +1,84 @@
+#include "client_registry.h"
+
+void rconpp::client_registry::insert(const connected_client& client) {
+	shard& target = shard_for(client.socket);
+	std::lock_guard lock(target.mutex);
+
+	if (target.clients.insert_or_assign(client.socket, client).second) {
+		count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	version.fetch_add(1, std::memory_order_release);
+}
+
+bool rconpp::client_registry::erase(const SOCKET_TYPE socket) {
+	shard& target = shard_for(socket);
+	std::lock_guard lock(target.mutex);
+
+	if (target.clients.erase(socket) == 0) {
+		return false;
+	}
+
+	count.fetch_sub(1, std::memory_order_relaxed);
+	version.fetch_add(1, std::memory_order_release);
+
+	return true;
+}
+
+std::optional<rconpp::connected_client> rconpp::client_registry::find(const SOCKET_TYPE socket) const {
+	const shard& target = shard_for(socket);
+	std::lock_guard lock(target.mutex);
+
+	auto found = target.clients.find(socket);
+
+	if (found == target.clients.end()) {
+		return std::nullopt;
+	}
+
+	return found->second;
+}
+
+bool rconpp::client_registry::contains(const SOCKET_TYPE socket) const {
+	const shard& target = shard_for(socket);
+	std::lock_guard lock(target.mutex);
+
+	return target.clients.find(socket) != target.clients.end();
+}
+
+rconpp::client_registry::client_list rconpp::client_registry::snapshot() const {
+	std::shared_ptr<const cached_list> state = std::atomic_load(&cached);
+
+	// Nothing has changed since the last list was built, so everyone can share it.
+	if (state && state->version == version.load(std::memory_order_acquire)) {
+		return client_list(state, &state->clients);
+	}
+
+	std::lock_guard lock(rebuild_mutex);
+
+	// Another thread may have rebuilt the list while we waited for it.
+	const uint64_t latest = version.load(std::memory_order_acquire);
+	state = std::atomic_load(&cached);
+
+	if (state && state->version == latest) {
+		return client_list(state, &state->clients);
+	}
+
+	auto rebuilt = std::make_shared<cached_list>();
+	rebuilt->version = latest;
+	rebuilt->clients.reserve(size());
+
+	// Shards are locked one at a time, so clients keep connecting on the other shards while the list is built.
+	// Anything that changes part way through bumps `version` past `latest`, and the next call builds a fresh list.
+	for (const shard& source : shards) {
+		std::lock_guard shard_lock(source.mutex);
+
+		for (const auto& [socket, client] : source.clients) {
+			rebuilt->clients.push_back(client);
+		}
+	}
+
+	state = rebuilt;
+	std::atomic_store(&cached, state);
+
+	return client_list(state, &state->clients);
+}
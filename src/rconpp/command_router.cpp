@@ -0,0 +1,197 @@
+#include "command_router.h"
+#include "server.h"
+
+namespace {
+
+constexpr std::string_view WHITESPACE = " \t\r\n";
+
+std::string_view trim_front(std::string_view text) {
+	const size_t start = text.find_first_not_of(WHITESPACE);
+	return start == std::string_view::npos ? std::string_view{} : text.substr(start);
+}
+
+} // namespace
+
+std::string_view rconpp::command_args::next() {
+	rest = trim_front(rest);
+
+	if (rest.empty()) {
+		return {};
+	}
+
+	if (rest.front() == '"') {
+		const size_t close = rest.find('"', 1);
+
+		// An unfinished quote runs to the end of the command.
+		if (close == std::string_view::npos) {
+			const std::string_view argument = rest.substr(1);
+			rest = {};
+			return argument;
+		}
+
+		const std::string_view argument = rest.substr(1, close - 1);
+		rest.remove_prefix(close + 1);
+		return argument;
+	}
+
+	const size_t end = rest.find_first_of(WHITESPACE);
+	const std::string_view argument = rest.substr(0, end);
+	rest.remove_prefix(end == std::string_view::npos ? rest.size() : end);
+	return argument;
+}
+
+std::string_view rconpp::command_args::remaining() const {
+	return trim_front(rest);
+}
+
+size_t rconpp::command_args::count() const {
+	command_args copy(rest);
+	size_t total = 0;
+
+	while (!copy.empty()) {
+		copy.next();
+		total++;
+	}
+
+	return total;
+}
+
+std::string_view rconpp::command_router::split(const std::string_view command, command_args& args) {
+	const std::string_view trimmed = trim_front(command);
+	const size_t end = trimmed.find_first_of(WHITESPACE);
+
+	if (end == std::string_view::npos) {
+		args = command_args{};
+		return trimmed;
+	}
+
+	args = command_args(trimmed.substr(end));
+	return trimmed.substr(0, end);
+}
+
+void rconpp::command_router::add(const std::string_view verb, handler function) {
+	if (const int32_t existing = find(verb); existing >= 0) {
+		routes[static_cast<size_t>(existing)]->function = std::move(function);
+		return;
+	}
+
+	auto added = std::make_unique<route>();
+	added->verb = std::string(verb);
+	added->hash = hash_verb(verb);
+	added->function = std::move(function);
+	routes.emplace_back(std::move(added));
+
+	if (table.size() < routes.size() * 2) {
+		rebuild_table();
+	} else {
+		size_t slot = routes.back()->hash & (table.size() - 1);
+
+		while (table[slot] != -1) {
+			slot = (slot + 1) & (table.size() - 1);
+		}
+
+		table[slot] = static_cast<int32_t>(routes.size() - 1);
+	}
+
+	link_static_routes();
+}
+
+void rconpp::command_router::rebuild_table() {
+	size_t capacity = 16;
+
+	while (capacity < routes.size() * 2) {
+		capacity *= 2;
+	}
+
+	table.assign(capacity, -1);
+
+	for (size_t i = 0; i < routes.size(); i++) {
+		size_t slot = routes[i]->hash & (capacity - 1);
+
+		while (table[slot] != -1) {
+			slot = (slot + 1) & (capacity - 1);
+		}
+
+		table[slot] = static_cast<int32_t>(i);
+	}
+}
+
+void rconpp::command_router::link_static_routes() {
+	if (!static_table) {
+		return;
+	}
+
+	for (size_t i = 0; i < routes.size(); i++) {
+		if (const int32_t index = static_find(static_table, routes[i]->verb); index >= 0) {
+			static_routes[static_cast<size_t>(index)] = static_cast<int32_t>(i);
+		}
+	}
+}
+
+int32_t rconpp::command_router::find(const std::string_view verb) const {
+	if (static_table) {
+		if (const int32_t index = static_find(static_table, verb); index >= 0 && static_routes[static_cast<size_t>(index)] >= 0) {
+			return static_routes[static_cast<size_t>(index)];
+		}
+	}
+
+	if (table.empty()) {
+		return -1;
+	}
+
+	const uint32_t hash = hash_verb(verb);
+	size_t slot = hash & (table.size() - 1);
+
+	// The table is never more than half full, so an empty slot always turns up.
+	while (table[slot] != -1) {
+		const route& candidate = *routes[static_cast<size_t>(table[slot])];
+
+		if (candidate.hash == hash && candidate.verb == verb) {
+			return table[slot];
+		}
+
+		slot = (slot + 1) & (table.size() - 1);
+	}
+
+	return -1;
+}
+
+bool rconpp::command_router::handles(const std::string_view command) const {
+	command_args args{};
+	return find(split(command, args)) >= 0;
+}
+
+bool rconpp::command_router::dispatch(const command_view& command, std::string& response) {
+	command_args args{};
+	const int32_t index = find(split(command.command, args));
+
+	if (index < 0) {
+		unrouted_commands.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	route& target = *routes[static_cast<size_t>(index)];
+
+	const auto started = std::chrono::steady_clock::now();
+	response = target.function(command, args);
+	target.latency.record(std::chrono::steady_clock::now() - started);
+
+	return true;
+}
+
+std::vector<rconpp::command_stats> rconpp::command_router::stats() const {
+	std::vector<command_stats> result{};
+	result.reserve(routes.size());
+
+	for (const auto& entry : routes) {
+		command_stats verb_stats{};
+		verb_stats.verb = entry->verb;
+		verb_stats.latency = entry->latency.snapshot();
+		verb_stats.calls = verb_stats.latency.count;
+		verb_stats.total_time = verb_stats.latency.sum;
+		verb_stats.max_time = verb_stats.latency.max;
+		result.emplace_back(std::move(verb_stats));
+	}
+
+	return result;
+}
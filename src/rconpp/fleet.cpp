@@ -0,0 +1,290 @@
+#include <algorithm>
+#include "fleet.h"
+#include "packet_decoder.h"
+#include "reactor.h"
+
+#ifndef _WIN32
+#include <netinet/tcp.h>
+#endif
+
+namespace {
+
+constexpr int32_t AUTH_ID = 1;
+constexpr int32_t COMMAND_ID = 2;
+constexpr int32_t TERMINATOR_ID = rconpp::INTERNAL_ID_START;
+
+/**
+ * @brief One server being worked on by `rcon_fleet::execute`.
+ */
+struct fleet_session {
+	const rconpp::rcon_endpoint* endpoint{nullptr};
+	rconpp::fleet_result* result{nullptr};
+
+	/**
+	 * @brief Where the server is, once `endpoint` has been checked.
+	 */
+	sockaddr_in peer{};
+
+	SOCKET_TYPE socket{INVALID_SOCKET};
+
+	bool connecting{false};
+	bool authenticated{false};
+	bool done{false};
+
+	rconpp::packet_decoder decoder{};
+	std::vector<char> write_buffer{};
+	size_t write_offset{0};
+};
+
+std::chrono::microseconds since(const std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+}
+
+} // namespace
+
+std::vector<rconpp::fleet_result> rconpp::rcon_fleet::execute(const std::vector<rcon_endpoint>& endpoints, const std::string_view command) {
+	std::vector<fleet_result> results(endpoints.size());
+	std::vector<fleet_session> sessions(endpoints.size());
+
+	if (endpoints.empty()) {
+		return results;
+	}
+
+	reactor events{};
+
+	const auto started_at = std::chrono::steady_clock::now();
+	const auto deadline = started_at + timeout;
+	size_t remaining = endpoints.size();
+
+	// The command is the same for every server, so its packets are only built once.
+	std::vector<char> command_bytes{};
+	append_packet(command_bytes, command, COMMAND_ID, SERVERDATA_EXECCOMMAND);
+
+	if (multi_packet == MULTI_PACKET_TERMINATOR) {
+		append_packet(command_bytes, "", TERMINATOR_ID, SERVERDATA_RESPONSE_VALUE);
+	}
+
+	// Nothing is formatted unless the record's level is high enough and something is listening.
+	auto log = [this](const fleet_session& session, const log_event event, const int error_code = 0) {
+		if (LOG_WARNING >= MIN_LOG_LEVEL && LOG_WARNING >= min_log_level) {
+			emit_log(log_record(LOG_WARNING, event).from(session.peer).with_id(session.endpoint->port).with_text(session.endpoint->address).with_error(error_code), on_log, on_log_record);
+		}
+	};
+
+	auto finish = [&](fleet_session& session, const fleet_status status) {
+		if (session.done) {
+			return;
+		}
+
+		session.done = true;
+		session.result->status = status;
+		session.result->total_time = since(started_at);
+
+		if (session.socket != INVALID_SOCKET) {
+			events.remove(session.socket);
+			close_socket(session.socket);
+			session.socket = INVALID_SOCKET;
+		}
+
+		if (--remaining == 0) {
+			events.stop();
+		}
+	};
+
+	auto flush = [&](fleet_session& session) -> bool {
+		while (session.write_offset < session.write_buffer.size()) {
+			const auto sent = ::send(session.socket, session.write_buffer.data() + session.write_offset, static_cast<int>(session.write_buffer.size() - session.write_offset), MSG_NOSIGNAL);
+
+			if (sent < 0) {
+				if (get_last_error().type_of_error == WOULD_BLOCK) {
+					events.modify(session.socket, IO_READABLE | IO_WRITABLE);
+					return true;
+				}
+
+				return false;
+			}
+
+			session.write_offset += static_cast<size_t>(sent);
+		}
+
+		events.modify(session.socket, IO_READABLE);
+		return true;
+	};
+
+	// Pulls every complete packet out of the decoder. Returns false if the server sent something that can't be a packet.
+	auto parse_packets = [&](fleet_session& session) -> bool {
+		decoded_packet packet{};
+		decode_result decoded{DECODE_NEED_MORE};
+
+		while (!session.done && (decoded = session.decoder.next(packet, max_packet_size)) == DECODE_PACKET) {
+			if (!session.authenticated) {
+				// Source servers send an empty SERVERDATA_RESPONSE_VALUE before the real answer, which we don't care about.
+				if (packet.type != SERVERDATA_AUTH_RESPONSE) {
+					continue;
+				}
+
+				if (packet.id != AUTH_ID) {
+					log(session, EVENT_FLEET_AUTH_FAILED);
+					finish(session, FLEET_AUTH_FAILED);
+					break;
+				}
+
+				session.authenticated = true;
+				session.result->auth_time = since(started_at);
+				continue;
+			}
+
+			if (packet.id == COMMAND_ID) {
+				session.result->result.data.append(packet.body);
+				session.result->result.server_responded = true;
+
+				if (multi_packet == MULTI_PACKET_NONE || (multi_packet == MULTI_PACKET_SIZE && packet.body.size() < full_packet_body_size)) {
+					finish(session, FLEET_OK);
+				}
+			} else if (packet.id == TERMINATOR_ID) {
+				session.result->result.server_responded = true;
+				finish(session, FLEET_OK);
+			}
+		}
+
+		return decoded != DECODE_INVALID;
+	};
+
+	auto on_connected = [&](fleet_session& session) {
+		session.connecting = false;
+		session.result->connect_time = since(started_at);
+
+		// The login and the command go out together, the server handles them in order so we don't wait a round trip in between.
+		session.write_buffer.reserve(packet_length(session.endpoint->password.size()) + command_bytes.size());
+		append_packet(session.write_buffer, session.endpoint->password, AUTH_ID, SERVERDATA_AUTH);
+		session.write_buffer.insert(session.write_buffer.end(), command_bytes.begin(), command_bytes.end());
+
+		if (!flush(session)) {
+			log(session, EVENT_FLEET_SEND_FAILED);
+			finish(session, FLEET_DISCONNECTED);
+		}
+	};
+
+	auto on_event = [&](fleet_session& session, const uint32_t ready) {
+		if (session.done) {
+			return;
+		}
+
+		if (session.connecting) {
+			int error = 0;
+			socklen_t error_size = sizeof(error);
+			getsockopt(session.socket, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &error_size);
+
+			if (error != 0) {
+				log(session, EVENT_FLEET_CONNECT_FAILED, error);
+				finish(session, FLEET_CONNECT_FAILED);
+				return;
+			}
+
+			on_connected(session);
+			return;
+		}
+
+		if ((ready & IO_WRITABLE) && !flush(session)) {
+			log(session, EVENT_FLEET_SEND_FAILED);
+			finish(session, FLEET_DISCONNECTED);
+			return;
+		}
+
+		if (ready & (IO_READABLE | IO_CLOSED)) {
+			bool closed = false;
+
+			while (!session.done) {
+				const auto received = recv(session.socket, session.decoder.prepare(READ_CHUNK_SIZE), static_cast<int>(READ_CHUNK_SIZE), 0);
+
+				if (received <= 0) {
+					closed = received == 0 || get_last_error().type_of_error != WOULD_BLOCK;
+					break;
+				}
+
+				session.decoder.commit(static_cast<size_t>(received));
+
+				if (!parse_packets(session)) {
+					log(session, EVENT_FLEET_INVALID_PACKET);
+					finish(session, FLEET_DISCONNECTED);
+					return;
+				}
+			}
+
+			if (closed && !session.done) {
+				log(session, EVENT_FLEET_CLOSED);
+				finish(session, FLEET_DISCONNECTED);
+			}
+		}
+	};
+
+	for (size_t i = 0; i < endpoints.size(); i++) {
+		fleet_session& session = sessions[i];
+		session.endpoint = &endpoints[i];
+		session.result = &results[i];
+
+		sockaddr_in& server = session.peer;
+		server.sin_family = AF_INET;
+		server.sin_port = htons(static_cast<uint16_t>(session.endpoint->port));
+
+		if (session.endpoint->port <= 0 || session.endpoint->port > 65535 || inet_pton(AF_INET, session.endpoint->address.c_str(), &server.sin_addr) != 1) {
+			log(session, EVENT_FLEET_INVALID_ADDRESS);
+			finish(session, FLEET_CONNECT_FAILED);
+			continue;
+		}
+
+		session.socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+		if (session.socket == INVALID_SOCKET || !set_non_blocking(session.socket)) {
+			log(session, EVENT_FLEET_SOCKET_FAILED, get_last_error().error_code);
+			finish(session, FLEET_CONNECT_FAILED);
+			continue;
+		}
+
+		// Requests are tiny and we want them out straight away.
+		const int no_delay = 1;
+		setsockopt(session.socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&no_delay), sizeof(no_delay));
+
+		const int status = connect(session.socket, reinterpret_cast<const sockaddr*>(&server), sizeof(server));
+
+		const last_error connect_error = status == SOCKET_ERROR ? get_last_error() : last_error{};
+
+		if (status == SOCKET_ERROR && connect_error.type_of_error != WOULD_BLOCK) {
+			log(session, EVENT_FLEET_CONNECT_FAILED, connect_error.error_code);
+			close_socket(session.socket);
+			session.socket = INVALID_SOCKET;
+			finish(session, FLEET_CONNECT_FAILED);
+			continue;
+		}
+
+		session.connecting = status == SOCKET_ERROR;
+
+		events.add(session.socket, session.connecting ? IO_WRITABLE : IO_READABLE, [&on_event, &session](const uint32_t ready) {
+			on_event(session, ready);
+		});
+
+		if (!session.connecting) {
+			on_connected(session);
+		}
+	}
+
+	if (remaining == 0) {
+		return results;
+	}
+
+	// The loop only wakes up for the deadline once, when it arrives. Anything still going by then is given up on.
+	const auto until_deadline = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+
+	events.set_tick(std::max(std::chrono::milliseconds(1), until_deadline), [&]() {
+		for (fleet_session& session : sessions) {
+			if (!session.done) {
+				log(session, EVENT_FLEET_TIMED_OUT);
+				finish(session, session.connecting ? FLEET_CONNECT_FAILED : FLEET_TIMED_OUT);
+			}
+		}
+	});
+
+	events.run();
+
+	return results;
+}
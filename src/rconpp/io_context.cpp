@@ -0,0 +1,50 @@
+#include <algorithm>
+#include "io_context.h"
+#include "client.h"
+
+rconpp::rcon_io_context::rcon_io_context(const unsigned int threads) {
+	const unsigned int loop_count = std::max(1u, threads);
+
+	loops.reserve(loop_count);
+
+	for (unsigned int i = 0; i < loop_count; i++) {
+		auto loop = std::make_unique<io_loop>();
+		io_loop* loop_ptr = loop.get();
+
+		// Requests that never got a response are checked for once a second, or sooner if a deadline needs it.
+		loop->events.set_tick(std::chrono::seconds(1), [loop_ptr]() {
+			// Expiring a request runs its callback, which may detach or destroy any client here (taking it out of `clients`), so a copy is walked instead.
+			loop_ptr->ticking.assign(loop_ptr->clients.begin(), loop_ptr->clients.end());
+
+			for (rcon_client* client : loop_ptr->ticking) {
+				if (loop_ptr->clients.count(client) != 0) {
+					loop_ptr->events.tick_before(client->expire_requests());
+				}
+			}
+
+			loop_ptr->ticking.clear();
+		});
+
+		loop->runner = std::thread([loop_ptr]() {
+			loop_ptr->events.run();
+		});
+
+		loops.emplace_back(std::move(loop));
+	}
+}
+
+rconpp::rcon_io_context::~rcon_io_context() {
+	for (auto& loop : loops) {
+		loop->events.stop();
+	}
+
+	for (auto& loop : loops) {
+		if (loop->runner.joinable()) {
+			loop->runner.join();
+		}
+	}
+}
+
+rconpp::rcon_io_context::io_loop& rconpp::rcon_io_context::pick_loop() {
+	return *loops[next_loop.fetch_add(1, std::memory_order_relaxed) % loops.size()];
+}
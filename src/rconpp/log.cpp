@@ -0,0 +1,296 @@
+#include "log.h"
+
+std::string rconpp::log_record::peer() const {
+	// Formatted by hand, as inet_ntoa shares one buffer between every thread.
+	const auto* octets = reinterpret_cast<const uint8_t*>(&address);
+
+	std::string result{};
+	result.reserve(21);
+
+	for (int i = 0; i < 4; i++) {
+		if (i > 0) {
+			result.push_back('.');
+		}
+
+		result.append(std::to_string(octets[i]));
+	}
+
+	result.push_back(':');
+	result.append(std::to_string(port));
+
+	return result;
+}
+
+std::string rconpp::log_record::message() const {
+	const std::string socket_text = std::to_string(socket);
+	const std::string error_text = std::to_string(error_code);
+
+	// Fleet servers are named as they were given, as they may not have an address we could connect to.
+	const auto fleet_server = [this]() {
+		return std::string(text) + ":" + std::to_string(id);
+	};
+
+	switch (event) {
+		case EVENT_SERVER_STARTING:
+			return "Attempting to startup an RCON server...";
+		case EVENT_SERVER_LISTENING:
+			return "Server is now listening, initiating runners...";
+		case EVENT_SERVER_READY:
+			return "Server is now ready!";
+		case EVENT_SERVER_START_FAILED:
+			return "RCON server is aborting as it failed to initiate server.";
+		case EVENT_SERVER_STOPPING:
+			return "RCON server is shutting down.";
+		case EVENT_CLIENT_CONNECTING:
+			return "Client [" + peer() + " | Socket: " + socket_text + "] is connecting to the server.";
+		case EVENT_CLIENT_CONNECTED:
+			return "Client [" + peer() + " | Socket: " + socket_text + "] has successfully connected to the server, asking for authentication.";
+		case EVENT_CLIENT_DISCONNECTED:
+			return "Client [" + peer() + " | Socket: " + socket_text + "] has been disconnected from the server.";
+		case EVENT_CLIENT_DROPPED:
+			return "Client [" + peer() + " | Socket: " + socket_text + "] is now being disconnected.";
+		case EVENT_CLIENT_UNKNOWN:
+			return "Client [Socket: " + socket_text + "] does not appear to be a connected client.";
+		case EVENT_ACCEPT_FAILED:
+			return "A new client attempted to join but failed [Error code: " + error_text + "]!";
+		case EVENT_WATCH_FAILED:
+			return "Failed to watch Client [Socket: " + socket_text + " | Error code: " + error_text + "]!";
+		case EVENT_AUTH_STARTED:
+			return "Client [" + peer() + "] not authenticated, handling authentication.";
+		case EVENT_AUTH_SUCCEEDED:
+			return "Client [" + peer() + "] has authenticated successfully!";
+		case EVENT_AUTH_FAILED:
+			return "Client [" + peer() + "] failed authentication!";
+		case EVENT_AUTH_ATTEMPTS_EXCEEDED:
+			return "Client [" + peer() + "] has attempted too many authentication attempts!";
+		case EVENT_INVALID_PACKET_TYPE:
+			return "Invalid packet type (" + std::to_string(id) + ") sent by [" + peer() + "]. Asking client to double check their packets.";
+		case EVENT_COMMAND_RECEIVED:
+			return "Client [" + peer() + "] has asked to execute the command: \"" + std::string(text) + "\"";
+		case EVENT_NO_COMMAND_HANDLER:
+			return "You have not set any response for on_command! The server will default to a blank response.";
+		case EVENT_HANDLER_QUEUE_FULL:
+			return "The command handler queue is full! Client [" + peer() + "] will get a blank response.";
+		case EVENT_RESPONSE_SENT:
+			return "Sending reply \"" + std::string(text) + "\" (of size: " + std::to_string(text.size()) + ", in " + std::to_string(size) + (size == 1 ? " packet" : " packets") + ") to client [" + peer() + "].";
+		case EVENT_HEARTBEAT_SENT:
+			return "Sending heartbeat to Client [" + peer() + "]";
+		case EVENT_HEARTBEAT_FAILED:
+			return "Failed to send a heartbeat to Client [" + peer() + "]!";
+		case EVENT_AUTH_TIMED_OUT:
+			return "Client [" + peer() + "] didn't log in in time, disconnecting!";
+		case EVENT_CLIENT_IDLE:
+			return "Client [" + peer() + "] hasn't sent anything in a while, disconnecting.";
+		case EVENT_BROADCAST_DROPPED:
+			return "Client [" + peer() + "] has " + std::to_string(size) + " bytes waiting to be sent, so a broadcast to it was dropped.";
+		case EVENT_CLIENT_STOPPING:
+			return "RCON client is shutting down.";
+		case EVENT_CONNECTING:
+			return "Attempting connection to RCON server...";
+		case EVENT_CONNECT_FAILED:
+			return "RCON++ is aborting as it failed to connect to the RCON server. Double check the IP and port.";
+		case EVENT_CONNECT_TIMED_OUT:
+			return "Timed out connecting to the RCON server.";
+		case EVENT_LOGGING_IN:
+			return "Connected successfully! Sending login data...";
+		case EVENT_LOGGED_IN:
+			return "Login Data sent successfully, we have been accepted!";
+		case EVENT_LOGIN_FAILED:
+			return "Login data was incorrect. RCON++ will now abort.";
+		case EVENT_NOT_CONNECTED:
+			return "Cannot send data when not connected.";
+		case EVENT_REQUEST_TOO_BIG:
+			return "The request with ID " + std::to_string(id) + " is too big to send. This request will not be sent.";
+		case EVENT_DUPLICATE_REQUEST_ID:
+			return "A request with ID " + std::to_string(id) + " is already waiting on a response! This request will not be sent.";
+		case EVENT_RESPONSE_TIMED_OUT:
+			return "Did not receive a packet in time. Did the server send a response?";
+		case EVENT_CONNECTION_LOST:
+			return "Lost connection to the RCON server.";
+		case EVENT_ALREADY_ATTACHED:
+			return "A client can only be attached to one rcon_io_context, before it starts.";
+		case EVENT_INVALID_ADDRESS:
+			return "Address is empty! You need to pass a valid address!";
+		case EVENT_INVALID_REQUEST_ID:
+			return "The request ID " + std::to_string(id) + " is negative, which is kept for the server. This request will not be sent.";
+		case EVENT_POOL_STARTED:
+			return "Client pool connected " + std::to_string(size) + " of " + std::to_string(id) + " clients.";
+		case EVENT_POOL_NOT_CONNECTED:
+			return "Cannot send data when no client in the pool is connected.";
+		case EVENT_POOL_CLIENT_REPLACED:
+			return "Client pool replaced a disconnected client.";
+		case EVENT_FLEET_INVALID_ADDRESS:
+			return fleet_server() + " is not a valid address.";
+		case EVENT_FLEET_SOCKET_FAILED:
+			return fleet_server() + " could not have a socket opened for it [Error code: " + error_text + "].";
+		case EVENT_FLEET_CONNECT_FAILED:
+			return fleet_server() + " could not be connected to [Error code: " + error_text + "].";
+		case EVENT_FLEET_SEND_FAILED:
+			return fleet_server() + " disconnected while sending.";
+		case EVENT_FLEET_AUTH_FAILED:
+			return fleet_server() + " refused the password.";
+		case EVENT_FLEET_INVALID_PACKET:
+			return fleet_server() + " sent something that isn't an RCON packet.";
+		case EVENT_FLEET_CLOSED:
+			return fleet_server() + " closed the connection before responding.";
+		case EVENT_FLEET_TIMED_OUT:
+			return fleet_server() + " ran out of time.";
+		case EVENT_INVALID_PORT:
+			return "Invalid port! The port can't exceed 65535!";
+		case EVENT_STARTUP_FAILED:
+			return "WSAStartup failed. Error: " + error_text;
+		case EVENT_SOCKET_FAILED:
+			return "Failed to open socket [Error code: " + error_text + "]!";
+		case EVENT_SEND_FAILED:
+			// Only the server's records have someone on the other end, the client only talks to its server.
+			return address != 0 ? "Failed to send a packet to Client [" + peer() + " | Error code: " + error_text + "]!" : "Sending failed [Error code: " + error_text + "]!";
+		case EVENT_RECEIVE_FAILED:
+			return address != 0 ? "Failed to receive the full packet from Client [" + peer() + " | Error code: " + error_text + "]!" : "Failed to receive from the RCON server [Error code: " + error_text + "]!";
+		case EVENT_INVALID_PACKET_SIZE:
+			return address != 0 ? "Client [" + peer() + "] sent an invalid packet size!" : "The server sent an invalid packet size!";
+	}
+
+	return std::string(event_name(event));
+}
+
+std::string_view rconpp::level_name(const log_level level) {
+	switch (level) {
+		case LOG_TRACE:
+			return "trace";
+		case LOG_DEBUG:
+			return "debug";
+		case LOG_INFO:
+			return "info";
+		case LOG_WARNING:
+			return "warning";
+		case LOG_ERROR:
+			return "error";
+		case LOG_OFF:
+			return "off";
+	}
+
+	return "unknown";
+}
+
+std::string_view rconpp::event_name(const log_event event) {
+	switch (event) {
+		case EVENT_SERVER_STARTING:
+			return "server_starting";
+		case EVENT_SERVER_LISTENING:
+			return "server_listening";
+		case EVENT_SERVER_READY:
+			return "server_ready";
+		case EVENT_SERVER_START_FAILED:
+			return "server_start_failed";
+		case EVENT_SERVER_STOPPING:
+			return "server_stopping";
+		case EVENT_CLIENT_CONNECTING:
+			return "client_connecting";
+		case EVENT_CLIENT_CONNECTED:
+			return "client_connected";
+		case EVENT_CLIENT_DISCONNECTED:
+			return "client_disconnected";
+		case EVENT_CLIENT_DROPPED:
+			return "client_dropped";
+		case EVENT_CLIENT_UNKNOWN:
+			return "client_unknown";
+		case EVENT_ACCEPT_FAILED:
+			return "accept_failed";
+		case EVENT_WATCH_FAILED:
+			return "watch_failed";
+		case EVENT_AUTH_STARTED:
+			return "auth_started";
+		case EVENT_AUTH_SUCCEEDED:
+			return "auth_succeeded";
+		case EVENT_AUTH_FAILED:
+			return "auth_failed";
+		case EVENT_AUTH_ATTEMPTS_EXCEEDED:
+			return "auth_attempts_exceeded";
+		case EVENT_INVALID_PACKET_TYPE:
+			return "invalid_packet_type";
+		case EVENT_COMMAND_RECEIVED:
+			return "command_received";
+		case EVENT_NO_COMMAND_HANDLER:
+			return "no_command_handler";
+		case EVENT_HANDLER_QUEUE_FULL:
+			return "handler_queue_full";
+		case EVENT_RESPONSE_SENT:
+			return "response_sent";
+		case EVENT_HEARTBEAT_SENT:
+			return "heartbeat_sent";
+		case EVENT_HEARTBEAT_FAILED:
+			return "heartbeat_failed";
+		case EVENT_BROADCAST_DROPPED:
+			return "broadcast_dropped";
+		case EVENT_AUTH_TIMED_OUT:
+			return "auth_timed_out";
+		case EVENT_CLIENT_IDLE:
+			return "client_idle";
+		case EVENT_CLIENT_STOPPING:
+			return "client_stopping";
+		case EVENT_CONNECTING:
+			return "connecting";
+		case EVENT_CONNECT_FAILED:
+			return "connect_failed";
+		case EVENT_CONNECT_TIMED_OUT:
+			return "connect_timed_out";
+		case EVENT_LOGGING_IN:
+			return "logging_in";
+		case EVENT_LOGGED_IN:
+			return "logged_in";
+		case EVENT_LOGIN_FAILED:
+			return "login_failed";
+		case EVENT_NOT_CONNECTED:
+			return "not_connected";
+		case EVENT_REQUEST_TOO_BIG:
+			return "request_too_big";
+		case EVENT_DUPLICATE_REQUEST_ID:
+			return "duplicate_request_id";
+		case EVENT_RESPONSE_TIMED_OUT:
+			return "response_timed_out";
+		case EVENT_CONNECTION_LOST:
+			return "connection_lost";
+		case EVENT_ALREADY_ATTACHED:
+			return "already_attached";
+		case EVENT_INVALID_ADDRESS:
+			return "invalid_address";
+		case EVENT_INVALID_REQUEST_ID:
+			return "invalid_request_id";
+		case EVENT_POOL_STARTED:
+			return "pool_started";
+		case EVENT_POOL_NOT_CONNECTED:
+			return "pool_not_connected";
+		case EVENT_POOL_CLIENT_REPLACED:
+			return "pool_client_replaced";
+		case EVENT_FLEET_INVALID_ADDRESS:
+			return "fleet_invalid_address";
+		case EVENT_FLEET_SOCKET_FAILED:
+			return "fleet_socket_failed";
+		case EVENT_FLEET_CONNECT_FAILED:
+			return "fleet_connect_failed";
+		case EVENT_FLEET_SEND_FAILED:
+			return "fleet_send_failed";
+		case EVENT_FLEET_AUTH_FAILED:
+			return "fleet_auth_failed";
+		case EVENT_FLEET_INVALID_PACKET:
+			return "fleet_invalid_packet";
+		case EVENT_FLEET_CLOSED:
+			return "fleet_closed";
+		case EVENT_FLEET_TIMED_OUT:
+			return "fleet_timed_out";
+		case EVENT_INVALID_PORT:
+			return "invalid_port";
+		case EVENT_STARTUP_FAILED:
+			return "startup_failed";
+		case EVENT_SOCKET_FAILED:
+			return "socket_failed";
+		case EVENT_SEND_FAILED:
+			return "send_failed";
+		case EVENT_RECEIVE_FAILED:
+			return "receive_failed";
+		case EVENT_INVALID_PACKET_SIZE:
+			return "invalid_packet_size";
+	}
+
+	return "unknown";
+}
@@ -0,0 +1,267 @@
+#include <cstdio>
+#include <ctime>
+#include "log_sink.h"
+
+namespace {
+
+/**
+ * @brief The most records the writer takes from the ring at once.
+ */
+constexpr size_t MAX_BATCH = 512;
+
+/**
+ * @brief How long the writer sleeps between checks when nothing wakes it. Only a backstop, pushes wake it straight away.
+ */
+constexpr std::chrono::milliseconds IDLE_WAIT{250};
+
+} // namespace
+
+rconpp::async_log_sink::async_log_sink(const std::string& path, const size_t capacity, const log_overflow _overflow) : overflow(_overflow) {
+	file = std::fopen(path.c_str(), "a");
+	start(capacity);
+}
+
+rconpp::async_log_sink::async_log_sink(batch_writer batch_callback, const size_t capacity, const log_overflow _overflow) : overflow(_overflow), writer(std::move(batch_callback)) {
+	start(capacity);
+}
+
+rconpp::async_log_sink::~async_log_sink() {
+	stopping = true;
+	wake();
+
+	if (runner.joinable()) {
+		runner.join();
+	}
+
+	if (file) {
+		std::fclose(file);
+	}
+}
+
+void rconpp::async_log_sink::start(const size_t capacity) {
+	size_t rounded = 2;
+
+	while (rounded < capacity) {
+		rounded *= 2;
+	}
+
+	slots = std::make_unique<slot[]>(rounded);
+	mask = rounded - 1;
+
+	// Each slot starts out ready for the first lap.
+	for (size_t i = 0; i < rounded; i++) {
+		slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	batch.reserve(MAX_BATCH);
+	batch_text.resize(MAX_BATCH);
+
+	runner = std::thread([this]() {
+		run();
+	});
+}
+
+bool rconpp::async_log_sink::try_push(const log_record& record) {
+	size_t position = enqueue_position.load(std::memory_order_relaxed);
+	slot* target = nullptr;
+
+	// A slot is free when its sequence matches the lap we're on, and full (from the last lap) when it's behind.
+	while (true) {
+		target = &slots[position & mask];
+
+		const size_t sequence = target->sequence.load(std::memory_order_acquire);
+		const auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+
+		if (difference == 0) {
+			if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (difference < 0) {
+			return false;
+		} else {
+			position = enqueue_position.load(std::memory_order_relaxed);
+		}
+	}
+
+	target->record = record;
+	target->text.assign(record.text.data(), record.text.size());
+	target->time = std::chrono::system_clock::now();
+
+	target->sequence.store(position + 1, std::memory_order_release);
+
+	return true;
+}
+
+bool rconpp::async_log_sink::push(const log_record& record) {
+	if (stopping.load(std::memory_order_relaxed)) {
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	while (!try_push(record)) {
+		if (overflow == LOG_OVERFLOW_DROP || stopping.load(std::memory_order_relaxed)) {
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		// The writer is behind, make sure it's awake and give it a moment to catch up.
+		wake();
+		std::this_thread::sleep_for(std::chrono::microseconds(50));
+	}
+
+	// Pairs with the writer going to sleep in `run`. Only pushes that race with it pay for the lock.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (sleeping.load(std::memory_order_relaxed)) {
+		wake();
+	}
+
+	return true;
+}
+
+void rconpp::async_log_sink::wake() {
+	std::lock_guard lock(wake_mutex);
+	signalled = true;
+	wake_condition.notify_one();
+}
+
+size_t rconpp::async_log_sink::pop_batch() {
+	size_t taken = 0;
+	size_t position = dequeue_position.load(std::memory_order_relaxed);
+
+	batch.clear();
+
+	while (taken < MAX_BATCH) {
+		slot& source = slots[position & mask];
+
+		// Claimed but not filled in yet (or empty), either way there's nothing more to take right now.
+		if (source.sequence.load(std::memory_order_acquire) != position + 1) {
+			break;
+		}
+
+		// Swapped rather than copied, so the slot gets the batch's old string (and its capacity) back.
+		std::swap(batch_text[taken], source.text);
+
+		log_entry& entry = batch.emplace_back();
+		entry.record = source.record;
+		entry.record.text = batch_text[taken];
+		entry.time = source.time;
+
+		// Free for the next lap.
+		source.sequence.store(position + mask + 1, std::memory_order_release);
+
+		position++;
+		taken++;
+	}
+
+	dequeue_position.store(position, std::memory_order_relaxed);
+
+	return taken;
+}
+
+void rconpp::async_log_sink::write_batch() {
+	if (writer) {
+		writer(batch);
+		return;
+	}
+
+	if (!file) {
+		return;
+	}
+
+	file_buffer.clear();
+
+	for (const log_entry& entry : batch) {
+		file_buffer.append(format(entry)).push_back('\n');
+	}
+
+	// The whole batch goes out in one write.
+	std::fwrite(file_buffer.data(), 1, file_buffer.size(), file);
+	std::fflush(file);
+}
+
+void rconpp::async_log_sink::run() {
+	while (true) {
+		const size_t taken = pop_batch();
+
+		if (taken > 0) {
+			write_batch();
+
+			written.fetch_add(taken, std::memory_order_relaxed);
+			batches.fetch_add(1, std::memory_order_relaxed);
+
+			{
+				std::lock_guard lock(wake_mutex);
+				written_position.store(dequeue_position.load(std::memory_order_relaxed), std::memory_order_release);
+			}
+
+			written_condition.notify_all();
+			continue;
+		}
+
+		if (stopping.load(std::memory_order_relaxed) && enqueue_position.load(std::memory_order_acquire) == dequeue_position.load(std::memory_order_relaxed)) {
+			break;
+		}
+
+		std::unique_lock lock(wake_mutex);
+
+		sleeping.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		// A push may have landed between the last pop and saying we're asleep, so check once more before waiting.
+		if (slots[dequeue_position.load(std::memory_order_relaxed) & mask].sequence.load(std::memory_order_acquire) != dequeue_position.load(std::memory_order_relaxed) + 1) {
+			wake_condition.wait_for(lock, IDLE_WAIT, [this]() {
+				return signalled;
+			});
+		}
+
+		signalled = false;
+		sleeping.store(false, std::memory_order_relaxed);
+	}
+}
+
+void rconpp::async_log_sink::flush() {
+	const size_t target = enqueue_position.load(std::memory_order_acquire);
+
+	wake();
+
+	std::unique_lock lock(wake_mutex);
+
+	written_condition.wait(lock, [this, target]() {
+		return written_position.load(std::memory_order_acquire) >= target;
+	});
+}
+
+rconpp::log_sink_stats rconpp::async_log_sink::stats() const {
+	log_sink_stats result{};
+
+	result.written = written.load(std::memory_order_relaxed);
+	result.dropped = dropped.load(std::memory_order_relaxed);
+	result.batches = batches.load(std::memory_order_relaxed);
+	result.queued = enqueue_position.load(std::memory_order_relaxed) - dequeue_position.load(std::memory_order_relaxed);
+
+	return result;
+}
+
+std::string rconpp::async_log_sink::format(const log_entry& entry) {
+	const std::time_t seconds = std::chrono::system_clock::to_time_t(entry.time);
+	const auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(entry.time.time_since_epoch()).count() % 1000;
+
+	std::tm utc{};
+#ifdef _WIN32
+	gmtime_s(&utc, &seconds);
+#else
+	gmtime_r(&seconds, &utc);
+#endif
+
+	char stamp[32];
+	const size_t length = std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &utc);
+	std::snprintf(stamp + length, sizeof(stamp) - length, ".%03dZ", static_cast<int>(milliseconds));
+
+	std::string line(stamp);
+	line.append(" ").append(level_name(entry.record.level));
+	line.append(" ").append(event_name(entry.record.event));
+	line.append(" ").append(entry.record.message());
+
+	return line;
+}
@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <utility>
+#include "metrics.h"
+
+size_t rconpp::latency_histogram::bucket_for(const uint64_t value) {
+	// Below SUB_BUCKETS every value gets a bucket of its own.
+	if (value < SUB_BUCKETS) {
+		return static_cast<size_t>(value);
+	}
+
+	// Find the highest set bit, without relying on compiler builtins.
+	int exponent = 0;
+	uint64_t shifted = value;
+
+	for (const int step : { 32, 16, 8, 4, 2, 1 }) {
+		if (shifted >> step) {
+			exponent += step;
+			shifted >>= step;
+		}
+	}
+
+	if (exponent >= MAX_EXPONENT) {
+		return BUCKET_COUNT - 1;
+	}
+
+	// The top SUB_BUCKET_BITS bits after the highest one pick the bucket within this power of two.
+	const uint64_t sub_bucket = (value >> (exponent - SUB_BUCKET_BITS)) - SUB_BUCKETS;
+
+	return static_cast<size_t>(SUB_BUCKETS + static_cast<uint64_t>(exponent - SUB_BUCKET_BITS) * SUB_BUCKETS + sub_bucket);
+}
+
+uint64_t rconpp::latency_histogram::bucket_upper_bound(const size_t bucket) {
+	if (bucket < SUB_BUCKETS) {
+		return static_cast<uint64_t>(bucket);
+	}
+
+	const uint64_t index = static_cast<uint64_t>(bucket) - SUB_BUCKETS;
+	const int shift = static_cast<int>(index / SUB_BUCKETS);
+	const uint64_t sub_bucket = index % SUB_BUCKETS + SUB_BUCKETS;
+
+	return ((sub_bucket + 1) << shift) - 1;
+}
+
+void rconpp::latency_histogram::record(const std::chrono::nanoseconds duration) {
+	const uint64_t value = duration.count() > 0 ? static_cast<uint64_t>(duration.count()) : 0;
+
+	buckets[bucket_for(value)].fetch_add(1, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_relaxed);
+	sum.fetch_add(value, std::memory_order_relaxed);
+
+	uint64_t lowest = min.load(std::memory_order_relaxed);
+
+	while (value < lowest && !min.compare_exchange_weak(lowest, value, std::memory_order_relaxed)) {}
+
+	uint64_t highest = max.load(std::memory_order_relaxed);
+
+	while (value > highest && !max.compare_exchange_weak(highest, value, std::memory_order_relaxed)) {}
+}
+
+rconpp::histogram_snapshot rconpp::latency_histogram::snapshot() const {
+	histogram_snapshot result{};
+	result.buckets.resize(BUCKET_COUNT);
+
+	// Values recorded while this runs may be in some fields and not others, which is fine for monitoring.
+	for (size_t i = 0; i < BUCKET_COUNT; i++) {
+		result.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+	}
+
+	result.count = count.load(std::memory_order_relaxed);
+	result.sum = std::chrono::nanoseconds(sum.load(std::memory_order_relaxed));
+
+	if (result.count > 0) {
+		result.min = std::chrono::nanoseconds(min.load(std::memory_order_relaxed));
+		result.max = std::chrono::nanoseconds(max.load(std::memory_order_relaxed));
+	}
+
+	return result;
+}
+
+std::chrono::nanoseconds rconpp::histogram_snapshot::percentile(const double percent) const {
+	uint64_t total = 0;
+
+	for (const uint64_t bucket_count : buckets) {
+		total += bucket_count;
+	}
+
+	if (total == 0) {
+		return std::chrono::nanoseconds(0);
+	}
+
+	const double clamped = std::min(100.0, std::max(0.0, percent));
+	const uint64_t wanted = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(clamped / 100.0 * static_cast<double>(total))));
+
+	uint64_t seen = 0;
+
+	for (size_t i = 0; i < buckets.size(); i++) {
+		seen += buckets[i];
+
+		if (seen >= wanted) {
+			// A bucket's top end can be past anything actually recorded, so it's kept within what we saw.
+			const auto bound = std::chrono::nanoseconds(latency_histogram::bucket_upper_bound(i));
+			return max.count() > 0 ? std::min(bound, max) : bound;
+		}
+	}
+
+	return max;
+}
+
+std::chrono::nanoseconds rconpp::histogram_snapshot::mean() const {
+	return count == 0 ? std::chrono::nanoseconds(0) : std::chrono::nanoseconds(sum.count() / static_cast<int64_t>(count));
+}
+
+void rconpp::metrics_writer::counter(const std::string_view name, const std::string_view help, const uint64_t value) {
+	text.append("# HELP ").append(name).append("_total ").append(help).append("\n");
+	text.append("# TYPE ").append(name).append("_total counter\n");
+	text.append(name).append("_total ").append(std::to_string(value)).append("\n");
+}
+
+void rconpp::metrics_writer::histogram(const std::string_view name, const std::string_view help, const std::string_view labels, const histogram_snapshot& histogram, const bool describe) {
+	if (describe) {
+		text.append("# HELP ").append(name).append(" ").append(help).append("\n");
+		text.append("# TYPE ").append(name).append(" summary\n");
+	}
+
+	auto seconds = [](const std::chrono::nanoseconds value) {
+		char formatted[32];
+		std::snprintf(formatted, sizeof(formatted), "%.9f", std::chrono::duration<double>(value).count());
+		return std::string(formatted);
+	};
+
+	const std::string label_prefix = labels.empty() ? std::string() : std::string(labels) + ",";
+
+	const std::pair<const char*, double> quantiles[] = { { "0.5", 50.0 }, { "0.9", 90.0 }, { "0.99", 99.0 }, { "0.999", 99.9 } };
+
+	for (const auto& [quantile, percent] : quantiles) {
+		text.append(name).append("{").append(label_prefix).append("quantile=\"").append(quantile).append("\"} ");
+		text.append(seconds(histogram.percentile(percent))).append("\n");
+	}
+
+	const std::string label_block = labels.empty() ? std::string() : "{" + std::string(labels) + "}";
+
+	text.append(name).append("_sum").append(label_block).append(" ").append(seconds(histogram.sum)).append("\n");
+	text.append(name).append("_count").append(label_block).append(" ").append(std::to_string(histogram.count)).append("\n");
+}
+
+std::string rconpp::metrics_writer::label(const std::string_view name, const std::string_view value) {
+	std::string result(name);
+	result.append("=\"");
+
+	for (const char c : value) {
+		if (c == '"' || c == '\\') {
+			result.push_back('\\');
+			result.push_back(c);
+		} else if (c == '\n') {
+			result.append("\\n");
+		} else {
+			result.push_back(c);
+		}
+	}
+
+	result.push_back('"');
+	return result;
+}
@@ -0,0 +1,90 @@
+#include <cstring>
+#include "packet_decoder.h"
+
+char* rconpp::packet_decoder::prepare(const size_t size) {
+	// Everything has been decoded, so the next read can start from the front again.
+	if (read_offset == write_offset) {
+		read_offset = 0;
+		write_offset = 0;
+	}
+
+	if (storage.size() - write_offset < size) {
+		// Slide the partial packet back to the front before growing, the space in front of it is free.
+		if (read_offset > 0) {
+			std::memmove(storage.data(), storage.data() + read_offset, write_offset - read_offset);
+			write_offset -= read_offset;
+			read_offset = 0;
+		}
+
+		if (storage.size() - write_offset < size) {
+			storage.resize(write_offset + size);
+		}
+	}
+
+	return storage.data() + write_offset;
+}
+
+void rconpp::packet_decoder::commit(const size_t size) {
+	write_offset += size;
+}
+
+void rconpp::packet_decoder::feed(const char* data, const size_t size) {
+	if (size == 0) {
+		return;
+	}
+
+	std::memcpy(prepare(size), data, size);
+	commit(size);
+}
+
+rconpp::decode_result rconpp::packet_decoder::next(decoded_packet& packet, const int32_t max_packet_size) {
+	while (write_offset - read_offset >= PACKET_SIZE_BYTES) {
+		const char* start = storage.data() + read_offset;
+
+		int32_t size{0};
+		std::memcpy(&size, start, sizeof(size));
+
+		// Checked before waiting on the rest of the packet, so a bad size can't make us hold (or allocate) any more than a read's worth.
+		if (size < 0 || size > max_packet_size) {
+			return DECODE_INVALID;
+		}
+
+		if (write_offset - read_offset < PACKET_SIZE_BYTES + static_cast<size_t>(size)) {
+			return DECODE_NEED_MORE;
+		}
+
+		read_offset += PACKET_SIZE_BYTES + static_cast<size_t>(size);
+
+		// Silently ignore packet sizes smaller than MIN_PACKET_SIZE,
+		// which indicates it's a valid packet but not a valid size.
+		if (size < MIN_PACKET_SIZE) {
+			continue;
+		}
+
+		std::memcpy(&packet.id, start + PACKET_SIZE_BYTES, sizeof(packet.id));
+		std::memcpy(&packet.type, start + PACKET_SIZE_BYTES + sizeof(packet.id), sizeof(packet.type));
+		packet.body = std::string_view(start + PACKET_HEADER_LENGTH, static_cast<size_t>(size - MIN_PACKET_SIZE));
+
+		return DECODE_PACKET;
+	}
+
+	return DECODE_NEED_MORE;
+}
+
+void rconpp::packet_decoder::clear() {
+	read_offset = 0;
+	write_offset = 0;
+}
+
+void rconpp::packet_decoder::use_buffer(std::vector<char>&& buffer) {
+	storage = std::move(buffer);
+
+	// The whole buffer is space for reads, so it doesn't have to grow until a read needs more than it already has.
+	storage.resize(storage.capacity());
+	clear();
+}
+
+std::vector<char> rconpp::packet_decoder::release_buffer() {
+	clear();
+	return std::move(storage);
+}
@@ -0,0 +1,351 @@
+#include "reactor.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#elif !defined(_WIN32)
+#include <poll.h>
+#endif
+
+#include <algorithm>
+
+namespace {
+
+// How many events a single epoll_wait call will hand back to us.
+constexpr int MAX_EVENTS_PER_WAIT = 256;
+
+// The loop `run` is running on this thread, for `reactor::current`.
+thread_local rconpp::reactor* current_loop = nullptr;
+
+#ifdef __linux__
+uint32_t to_epoll_events(const uint32_t events) {
+	uint32_t result = EPOLLRDHUP;
+
+	if (events & rconpp::IO_READABLE) {
+		result |= EPOLLIN;
+	}
+
+	if (events & rconpp::IO_WRITABLE) {
+		result |= EPOLLOUT;
+	}
+
+	return result;
+}
+#endif
+
+} // namespace
+
+rconpp::reactor::reactor() {
+#ifdef __linux__
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	epoll_event ev{};
+	ev.events = EPOLLIN;
+	ev.data.fd = wake_fd;
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+#elif defined(_WIN32)
+	WSADATA wsa_data;
+	WSAStartup(MAKEWORD(2, 2), &wsa_data);
+
+	// Windows has no pipes that can be polled alongside sockets, so we use a loopback UDP socket that talks to itself.
+	wake_receiver = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+	sockaddr_in loopback{};
+	loopback.sin_family = AF_INET;
+	loopback.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	loopback.sin_port = 0;
+	bind(wake_receiver, reinterpret_cast<const sockaddr*>(&loopback), sizeof(loopback));
+
+	int loopback_len = sizeof(loopback);
+	getsockname(wake_receiver, reinterpret_cast<sockaddr*>(&loopback), &loopback_len);
+
+	wake_sender = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	connect(wake_sender, reinterpret_cast<const sockaddr*>(&loopback), sizeof(loopback));
+
+	set_non_blocking(wake_receiver);
+	set_non_blocking(wake_sender);
+#else
+	int fds[2];
+	if (pipe(fds) == 0) {
+		wake_receiver = fds[0];
+		wake_sender = fds[1];
+		set_non_blocking(wake_receiver);
+		set_non_blocking(wake_sender);
+	}
+#endif
+}
+
+rconpp::reactor::~reactor() {
+	stop();
+
+#ifdef __linux__
+	close(wake_fd);
+	close(epoll_fd);
+#elif defined(_WIN32)
+	closesocket(wake_receiver);
+	closesocket(wake_sender);
+	WSACleanup();
+#else
+	close(wake_receiver);
+	close(wake_sender);
+#endif
+}
+
+bool rconpp::reactor::add(const SOCKET_TYPE socket, const uint32_t events, io_callback callback) {
+	auto handler = std::make_shared<io_handler>();
+	handler->callback = std::move(callback);
+	handler->events = events;
+
+#ifdef __linux__
+	epoll_event ev{};
+	ev.events = to_epoll_events(events);
+	ev.data.fd = socket;
+
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, socket, &ev) == -1) {
+		return false;
+	}
+#endif
+
+	handlers[socket] = std::move(handler);
+
+	return true;
+}
+
+bool rconpp::reactor::modify(const SOCKET_TYPE socket, const uint32_t events) {
+	auto found = handlers.find(socket);
+
+	if (found == handlers.end()) {
+		return false;
+	}
+
+	if (found->second->events == events) {
+		return true;
+	}
+
+#ifdef __linux__
+	epoll_event ev{};
+	ev.events = to_epoll_events(events);
+	ev.data.fd = socket;
+
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, socket, &ev) == -1) {
+		return false;
+	}
+#endif
+
+	found->second->events = events;
+
+	return true;
+}
+
+void rconpp::reactor::remove(const SOCKET_TYPE socket) {
+	if (handlers.erase(socket) == 0) {
+		return;
+	}
+
+#ifdef __linux__
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, socket, nullptr);
+#endif
+}
+
+void rconpp::reactor::post(std::function<void()> task) {
+	{
+		std::lock_guard lock(tasks_mutex);
+		tasks.emplace_back(std::move(task));
+	}
+
+	// Only the first post since the loop last woke up needs to pay for a syscall.
+	if (!wake_pending.exchange(true)) {
+		wake();
+	}
+}
+
+void rconpp::reactor::set_tick(const std::chrono::milliseconds interval, std::function<void()> tick) {
+	tick_interval = interval;
+	on_tick = std::move(tick);
+	next_tick = std::chrono::steady_clock::now() + interval;
+}
+
+void rconpp::reactor::run() {
+	loop_thread = std::this_thread::get_id();
+	current_loop = this;
+	finished = false;
+	running = true;
+
+	while (running) {
+		int timeout = -1;
+
+		if (on_tick) {
+			const auto until_tick = std::chrono::ceil<std::chrono::milliseconds>(next_tick - std::chrono::steady_clock::now());
+			timeout = static_cast<int>(std::max<int64_t>(0, until_tick.count()));
+		}
+
+		poll_once(timeout);
+
+		run_tasks();
+
+		if (on_tick && std::chrono::steady_clock::now() >= next_tick) {
+			next_tick = std::chrono::steady_clock::now() + tick_interval;
+			on_tick();
+		}
+	}
+
+	// Anything posted during shutdown still gets a chance to run (usually cleanup).
+	run_tasks();
+
+	current_loop = nullptr;
+	loop_thread = std::thread::id{};
+	finished = true;
+}
+
+rconpp::reactor* rconpp::reactor::current() {
+	return current_loop;
+}
+
+void rconpp::reactor::stop() {
+	running = false;
+	wake();
+}
+
+void rconpp::reactor::run_tasks() {
+	std::vector<std::function<void()>> to_run{};
+
+	{
+		std::lock_guard lock(tasks_mutex);
+		to_run.swap(tasks);
+	}
+
+	for (auto& task : to_run) {
+		task();
+	}
+}
+
+void rconpp::reactor::wake() {
+#ifdef __linux__
+	const uint64_t one = 1;
+	[[maybe_unused]] const auto written = write(wake_fd, &one, sizeof(one));
+#elif defined(_WIN32)
+	const char one = 1;
+	send(wake_sender, &one, 1, 0);
+#else
+	const char one = 1;
+	[[maybe_unused]] const auto written = write(wake_sender, &one, 1);
+#endif
+}
+
+void rconpp::reactor::drain_wake() {
+	wake_pending = false;
+
+#ifdef __linux__
+	uint64_t value = 0;
+	[[maybe_unused]] const auto read_bytes = read(wake_fd, &value, sizeof(value));
+#else
+	char buffer[64];
+#ifdef _WIN32
+	while (recv(wake_receiver, buffer, sizeof(buffer), 0) > 0) {}
+#else
+	while (read(wake_receiver, buffer, sizeof(buffer)) > 0) {}
+#endif
+#endif
+}
+
+void rconpp::reactor::dispatch(const SOCKET_TYPE socket, const uint32_t events) {
+	auto found = handlers.find(socket);
+
+	if (found == handlers.end()) {
+		return;
+	}
+
+	// Keep the handler alive, the callback is allowed to remove itself.
+	const std::shared_ptr<io_handler> handler = found->second;
+	handler->callback(events);
+}
+
+void rconpp::reactor::poll_once(const int timeout) {
+#ifdef __linux__
+	epoll_event events[MAX_EVENTS_PER_WAIT];
+
+	const int count = epoll_wait(epoll_fd, events, MAX_EVENTS_PER_WAIT, timeout);
+
+	for (int i = 0; i < count; i++) {
+		if (events[i].data.fd == wake_fd) {
+			drain_wake();
+			continue;
+		}
+
+		uint32_t ready = 0;
+
+		if (events[i].events & EPOLLIN) {
+			ready |= IO_READABLE;
+		}
+
+		if (events[i].events & EPOLLOUT) {
+			ready |= IO_WRITABLE;
+		}
+
+		if (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+			ready |= IO_CLOSED;
+		}
+
+		dispatch(events[i].data.fd, ready);
+	}
+#else
+#ifdef _WIN32
+	std::vector<WSAPOLLFD> fds{};
+#else
+	std::vector<pollfd> fds{};
+#endif
+	fds.reserve(handlers.size() + 1);
+	fds.push_back({ wake_receiver, POLLIN, 0 });
+
+	for (const auto& [socket, handler] : handlers) {
+		short wanted = 0;
+
+		if (handler->events & IO_READABLE) {
+			wanted |= POLLIN;
+		}
+
+		if (handler->events & IO_WRITABLE) {
+			wanted |= POLLOUT;
+		}
+
+		fds.push_back({ socket, wanted, 0 });
+	}
+
+#ifdef _WIN32
+	const int count = WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), timeout);
+#else
+	const int count = poll(fds.data(), fds.size(), timeout);
+#endif
+
+	if (count <= 0) {
+		return;
+	}
+
+	if (fds[0].revents & POLLIN) {
+		drain_wake();
+	}
+
+	for (size_t i = 1; i < fds.size(); i++) {
+		if (fds[i].revents == 0) {
+			continue;
+		}
+
+		uint32_t ready = 0;
+
+		if (fds[i].revents & POLLIN) {
+			ready |= IO_READABLE;
+		}
+
+		if (fds[i].revents & POLLOUT) {
+			ready |= IO_WRITABLE;
+		}
+
+		if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+			ready |= IO_CLOSED;
+		}
+
+		dispatch(fds[i].fd, ready);
+	}
+#endif
+}
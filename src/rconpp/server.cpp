@@ -1,36 +1,82 @@
 #include <mutex>
 #include <csignal>
+#include <algorithm>
 #include "server.h"
 
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
 #include "utilities.h"
 
+namespace {
+
+// The most segments handed to a single scatter/gather send.
+constexpr size_t MAX_WRITE_SEGMENTS = 64;
+
+// Every packet body is followed by two null bytes.
+constexpr char PACKET_TERMINATOR[2] = { 0, 0 };
+
+} // namespace
+
 rconpp::rcon_server::rcon_server(const std::string_view addr, const int _port, const std::string_view pass) : address(addr), port(_port), password(pass) {
 }
 
 rconpp::rcon_server::~rcon_server() {
-	if (on_log) {
-		on_log("RCON server is shutting down.");
-	}
+	log(log_record(LOG_INFO, EVENT_SERVER_STOPPING));
 
 	// Set connected to false, meaning no requests can be attempted during shutdown.
 	online = false;
 
 	terminating.notify_all();
 
-	// Safely disconnect all clients from server.
-	for(const auto& client : connected_clients) {
-		disconnect_client(client.first, false);
+	/*
+	 * Handlers post their responses to the loops, so they have to stop first.
+	 * The pool itself stays until the loops have stopped, as they may still be handing it commands (which it now refuses).
+	 */
+	if (command_handlers) {
+		command_handlers->stop();
+	}
+
+	// Any responder still out there is about to be left with a dangling server, so it's told to do nothing from now on.
+	{
+		std::unique_lock lock(responders->mutex);
+		responders->alive = false;
+	}
+
+	for (auto& loop : loops) {
+		loop->events.stop();
+	}
+
+	for (auto& loop : loops) {
+		if (loop->runner.joinable()) {
+			loop->runner.join();
+		}
+	}
+
+	command_handlers.reset();
+
+	// Every loop has stopped, so nothing else can touch the connections now. Safely disconnect all clients from server.
+	for (auto& loop : loops) {
+		std::vector<SOCKET_TYPE> sockets{};
+		sockets.reserve(loop->connections.size());
+
+		for (const auto& [client_socket, conn] : loop->connections) {
+			sockets.push_back(client_socket);
+		}
+
+		for (const SOCKET_TYPE client_socket : sockets) {
+			close_connection(*loop, client_socket);
+		}
+	}
+
+	if (sock != INVALID_SOCKET) {
+		close_socket(sock);
 	}
 
 #ifdef _WIN32
-	closesocket(sock);
 	WSACleanup();
-#else
-	close(sock);
 #endif
-	if (accept_connections_runner.joinable()) {
-		accept_connections_runner.join();
-	}
 }
 
 bool rconpp::rcon_server::startup_server() {
@@ -39,7 +85,7 @@ bool rconpp::rcon_server::startup_server() {
 	WSADATA wsa_data;
 	int result = WSAStartup(MAKEWORD(2, 2), &wsa_data);
 	if (result != 0) {
-		on_log("WSAStartup failed. Error: " + std::to_string(result));
+		log(log_record(LOG_ERROR, EVENT_STARTUP_FAILED).with_error(result));
 		return false;
 	}
 #else
@@ -55,7 +101,7 @@ bool rconpp::rcon_server::startup_server() {
 	if (sock == -1) {
 #endif
 		const last_error err = get_last_error();
-		on_log("Failed to open socket [Error code: " + std::to_string(err.error_code) + "]!");
+		log(log_record(LOG_ERROR, EVENT_SOCKET_FAILED).with_error(err.error_code));
 		return false;
 	}
 
@@ -82,184 +128,799 @@ bool rconpp::rcon_server::startup_server() {
 		return false;
 	}
 
-	return true;
+	// The listening socket lives in an event loop, accept() should never block it.
+	return set_non_blocking(sock);
 }
 
 void rconpp::rcon_server::disconnect_client(const SOCKET_TYPE client_socket, const bool remove_after /*= true*/) {
+	if (!connected_clients.contains(client_socket)) {
+		log(log_record(LOG_WARNING, EVENT_CLIENT_UNKNOWN).with_socket(client_socket));
+		return;
+	}
 
-#ifdef _WIN32
-	closesocket(client_socket);
-#else
-	close(client_socket);
-#endif
+	// Only the loop that owns the socket will find it, the others will ignore the request.
+	for (auto& loop : loops) {
+		io_loop* target = loop.get();
 
-	if (connected_clients.find(client_socket) == connected_clients.end())
-	{
-		on_log("Client [Socket: " + std::to_string(client_socket) + "] does not appear to be a connected client.");
+		if (target->events.in_loop_thread()) {
+			close_connection(*target, client_socket, remove_after);
+		} else {
+			target->events.post([this, target, client_socket, remove_after]() {
+				close_connection(*target, client_socket, remove_after);
+			});
+		}
+	}
+}
+
+size_t rconpp::rcon_server::broadcast(const std::string_view message, const std::function<bool(const connected_client& client)>& filter) {
+	if (!online || loops.empty()) {
+		return 0;
+	}
+
+	// Sockets are reused, so each target keeps its ID too. A client that connects on the same socket before the loop gets to it is left alone.
+	auto targets = std::make_shared<std::vector<std::pair<SOCKET_TYPE, uint64_t>>>();
+	const client_registry::client_list listed = connected_clients.snapshot();
+
+	for (const connected_client& client : *listed) {
+		if (client.connected && client.authenticated && (!filter || filter(client))) {
+			targets->emplace_back(client.socket, client.id);
+		}
+	}
+
+	if (targets->empty()) {
+		return 0;
+	}
+
+	const size_t body_limit = static_cast<size_t>(std::max(max_packet_size.load(), MIN_PACKET_SIZE + 1) - MIN_PACKET_SIZE);
+	const size_t packet_count = message.empty() ? 1 : (message.size() + body_limit - 1) / body_limit;
+
+	// Every packet is encoded back to back into one buffer, which all the clients share.
+	std::string encoded(message.size() + packet_count * static_cast<size_t>(MIN_PACKET_LENGTH), '\0');
+	size_t written = 0;
+
+	for (size_t offset = 0; offset == 0 || offset < message.size(); offset += body_limit) {
+		const std::string_view body = message.substr(offset, std::min(body_limit, message.size() - offset));
+		written += encode_packet(encoded.data() + written, encoded.size() - written, body, BROADCAST_PACKET_ID, SERVERDATA_RESPONSE_VALUE);
+	}
+
+	encoded.resize(written);
+
+	const auto shared = std::make_shared<const std::string>(std::move(encoded));
+
+	// Always posted, even from a loop's own thread, so a broadcast from a command handler never flushes (or closes) the client being read.
+	for (auto& loop : loops) {
+		io_loop* target = loop.get();
+
+		target->events.post([this, target, shared, packet_count, targets]() {
+			deliver_broadcast(*target, shared, packet_count, *targets);
+		});
+	}
+
+	return targets->size();
+}
+
+void rconpp::rcon_server::close_connection(io_loop& loop, const SOCKET_TYPE client_socket, const bool remove_after /*= true*/) {
+	auto found = loop.connections.find(client_socket);
+
+	if (found == loop.connections.end()) {
 		return;
 	}
 
-	connected_client& client = connected_clients.at(client_socket);
+	const std::shared_ptr<connection> conn = found->second;
 
-	client.connected = false;
-	client.authenticated = false;
-	
-	on_log("Client [" + std::string(inet_ntoa(client.sock_info.sin_addr)) + ":" + std::to_string(ntohs(client.sock_info.sin_port)) + " | Socket: " + std::to_string(client_socket) + "] has been disconnected from the server.");
+	loop.events.remove(client_socket);
+	loop.timers.cancel(conn->timer);
+	loop.connections.erase(found);
 
+	conn->info.connected = false;
+	conn->info.authenticated = false;
+
+	counters.connections_closed.add();
+
+	// Nothing is read or written once the client is disconnected, so its buffers can go to the next client straight away.
+	conn->write_queue.clear();
+	conn->write_head = 0;
+	conn->write_offset = 0;
+	conn->pending_bytes = 0;
+	buffers.release(conn->decoder.release_buffer());
+	buffers.release(std::move(conn->write_buffer));
+
+	log(log_record(LOG_INFO, EVENT_CLIENT_DISCONNECTED).from(conn->info.sock_info).with_socket(client_socket));
+
+	// The client has to be forgotten before the socket is closed, otherwise a new client could be given the same socket and be removed instead.
 	if (remove_after) {
-		{
-			while (!request_handlers_mutex.try_lock()) {
-				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		connected_clients.erase(client_socket);
+	} else {
+		connected_clients.update(client_socket, [](connected_client& client) {
+			client.connected = false;
+			client.authenticated = false;
+		});
+	}
+
+	close_socket(client_socket);
+}
+
+void rconpp::rcon_server::accept_clients() {
+	// The listening socket is non-blocking, so we take every pending client in one go until accept tells us there are none left.
+	while (online) {
+		sockaddr_in client_info{};
+
+		socklen_t client_len = sizeof(client_info);
+#ifdef __linux__
+		SOCKET_TYPE client_socket = accept4(sock, reinterpret_cast<sockaddr*>(&client_info), &client_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+		SOCKET_TYPE client_socket = accept(sock, reinterpret_cast<sockaddr*>(&client_info), &client_len);
+#endif
+
+		if (client_socket == INVALID_SOCKET) {
+			const last_error err = get_last_error();
+
+			if (err.type_of_error != WOULD_BLOCK) {
+				log(log_record(LOG_WARNING, EVENT_ACCEPT_FAILED).with_error(err.error_code));
 			}
 
-			request_handlers.erase(client_socket);
+			return;
+		}
 
-			request_handlers_mutex.unlock();
+#ifndef __linux__
+		set_non_blocking(client_socket);
+#endif
+
+		log(log_record(LOG_DEBUG, EVENT_CLIENT_CONNECTING).from(client_info).with_socket(client_socket));
+
+		auto conn = std::make_shared<connection>();
+
+		conn->info.sock_info = client_info;
+		conn->info.socket = client_socket;
+		conn->info.id = next_client_id.fetch_add(1, std::memory_order_relaxed) + 1;
+		conn->info.connected = true;
+		// We don't want to send a heartbeat instantly and confuse clients.
+		conn->info.last_heartbeat = time(nullptr);
+		conn->connected_at = std::chrono::steady_clock::now();
+		conn->last_received = conn->connected_at;
+		conn->last_heartbeat = conn->connected_at;
+
+		conn->decoder.use_buffer(buffers.acquire());
+		conn->write_buffer = buffers.acquire();
+
+		counters.connections_accepted.add();
+
+		connected_clients.insert(conn->info);
+
+		io_loop* target = loops[next_loop++ % loops.size()].get();
+		conn->owner = target;
+
+		if (target->events.in_loop_thread()) {
+			register_connection(*target, conn);
+		} else {
+			target->events.post([this, target, conn]() {
+				register_connection(*target, conn);
+			});
 		}
 
-		remove_client(client_socket);
+		log(log_record(LOG_INFO, EVENT_CLIENT_CONNECTED).from(client_info).with_socket(client_socket));
 	}
 }
 
-void rconpp::rcon_server::read_packet(connected_client& client) {
-	const int packet_size = read_packet_size(client.socket);
+void rconpp::rcon_server::register_connection(io_loop& loop, const std::shared_ptr<connection>& conn) {
+	const SOCKET_TYPE client_socket = conn->info.socket;
 
-	if (packet_size == -1) {
-		const last_error err = get_last_error();
-		on_log("Failed to read packet size from Client [" + std::string(inet_ntoa(client.sock_info.sin_addr)) + ":" + std::to_string(ntohs(client.sock_info.sin_port)) + " | Error code: " + std::to_string(err.error_code) + "]!");
+	loop.connections[client_socket] = conn;
 
-		// Since the client looks to have disconnected, we need to check their heartbeat immediately.
-		if (err.type_of_error == DISCONNECTED) {
-			client.last_heartbeat = 0;
-		}
+	const bool watching = loop.events.add(client_socket, IO_READABLE, [this, &loop, client_socket](const uint32_t events) {
+		on_connection_event(loop, client_socket, events);
+	});
 
+	if (!watching) {
+		const last_error err = get_last_error();
+		log(log_record(LOG_WARNING, EVENT_WATCH_FAILED).from(conn->info.sock_info).with_socket(client_socket).with_error(err.error_code));
+		close_connection(loop, client_socket);
 		return;
 	}
 
-	// Silently ignore packet sizes bigger than -1 but smaller than MIN_PACKET_SIZE,
-	// which indicates it's a valid packet but not a valid size.
-	if (packet_size < MIN_PACKET_SIZE) {
+	// The timer is cancelled when the connection is closed, so whenever it fires the connection is still on its loop.
+	conn->timer.context = conn.get();
+	conn->timer.callback = [](void* context) {
+		connection& target = *static_cast<connection*>(context);
+		io_loop& owner = *target.owner;
+
+		// Held until we're done, as the connection may be closed (and dropped by the loop) along the way.
+		if (auto found = owner.connections.find(target.info.socket); found != owner.connections.end()) {
+			const std::shared_ptr<connection> alive = found->second;
+			owner.server->check_timers(owner, alive);
+		}
+	};
+
+	check_timers(loop, conn);
+	loop.events.tick_before(loop.timers.next_expiry());
+}
+
+void rconpp::rcon_server::on_connection_event(io_loop& loop, const SOCKET_TYPE client_socket, const uint32_t events) {
+	auto found = loop.connections.find(client_socket);
+
+	if (found == loop.connections.end()) {
 		return;
 	}
 
-	std::vector<char> buffer{};
-	buffer.resize(packet_size);
+	const std::shared_ptr<connection> conn = found->second;
 
-	if (recv(client.socket, buffer.data(), packet_size, MSG_NOSIGNAL) == -1) {
-		const last_error err = get_last_error();
-		on_log("Failed to receive the full packet from Client [" + std::string(inet_ntoa(client.sock_info.sin_addr)) + ":" + std::to_string(ntohs(client.sock_info.sin_port)) + " | Error code: " + std::to_string(err.error_code) + "]!");
+	if (events & (IO_READABLE | IO_CLOSED)) {
+		conn->reading = true;
 
-		// Since the client looks to have disconnected, we need to check their heartbeat immediately.
-		if (err.type_of_error == DISCONNECTED) {
-			client.last_heartbeat = 0;
+		if (!read_packets(conn)) {
+			conn->info.connected = false;
 		}
 
-		return;
+		conn->reading = false;
 	}
 
-	// Client is talking to us, we don't need to send a heartbeat if we're being talked to.
-	client.last_heartbeat = time(nullptr);
+	// Everything queued while handling this read goes out together.
+	if (conn->info.connected && !flush(*conn)) {
+		conn->info.connected = false;
+	} else if (!conn->info.connected) {
+		// Whatever we queued before deciding to drop the client (like a refused login) gets one last chance to reach them.
+		flush(*conn);
+	}
+
+	if (!conn->info.connected) {
+		close_connection(loop, client_socket);
+	}
+}
+
+bool rconpp::rcon_server::read_packets(const std::shared_ptr<connection>& conn_ptr) {
+	connection& conn = *conn_ptr;
+	connected_client& client = conn.info;
+
+	// Drain the socket, we will not be told about this data again.
+	while (client.connected) {
+		const auto received = recv(client.socket, conn.decoder.prepare(READ_CHUNK_SIZE), static_cast<int>(READ_CHUNK_SIZE), MSG_NOSIGNAL);
+
+		if (received == 0) {
+			return false;
+		}
+
+		if (received < 0) {
+			const last_error err = get_last_error();
+
+			if (err.type_of_error == WOULD_BLOCK) {
+				break;
+			}
+
+			log(log_record(LOG_WARNING, EVENT_RECEIVE_FAILED).from(client.sock_info).with_socket(client.socket).with_error(err.error_code));
+			return false;
+		}
 
-	std::string packet_data(&buffer[8], &buffer[buffer.size()-2]);
-	int id = bit32_to_int(buffer);
-	int type = type_to_int(buffer);
+		conn.decoder.commit(static_cast<size_t>(received));
 
-	packet packet_to_send{};
+		// Client is talking to us, we don't need to send a heartbeat if we're being talked to.
+		conn.last_received = std::chrono::steady_clock::now();
+		counters.bytes_in.add(static_cast<uint64_t>(received));
+
+		// Every packet that came in with this read is handled before the next one, so the decoder only ever holds part of a packet between reads.
+		decoded_packet packet{};
+		decode_result result{DECODE_NEED_MORE};
+
+		while (client.connected && (result = conn.decoder.next(packet, max_packet_size)) == DECODE_PACKET) {
+			counters.packets_in.add();
+			handle_packet(conn_ptr, packet.id, packet.type, packet.body);
+		}
+
+		// Anything outside of the size bounds means the stream can't be trusted anymore.
+		if (result == DECODE_INVALID) {
+			log(log_record(LOG_WARNING, EVENT_INVALID_PACKET_SIZE).from(client.sock_info).with_socket(client.socket));
+			return false;
+		}
+	}
+
+	return client.connected;
+}
+
+void rconpp::rcon_server::handle_packet(const std::shared_ptr<connection>& conn_ptr, const int32_t id, const int32_t type, const std::string_view body) {
+	connection& conn = *conn_ptr;
+	connected_client& client = conn.info;
 
 	if (!client.authenticated) {
-		on_log("Client not authenticated, handling authentication.");
-		if (packet_data == password) {
-			packet_to_send = form_packet("", id, SERVERDATA_AUTH_RESPONSE);
+		log(log_record(LOG_TRACE, EVENT_AUTH_STARTED).from(client.sock_info).with_socket(client.socket).with_id(id));
+		if (body == password) {
+			queue_packet(conn, "", id, SERVERDATA_AUTH_RESPONSE);
 			client.authenticated = true;
-			on_log("Client [" + std::string(inet_ntoa(client.sock_info.sin_addr)) + ":" + std::to_string(ntohs(client.sock_info.sin_port)) + "] has authenticated successfully!");
+			counters.auth_successes.add();
+
+			connected_clients.update(client.socket, [](connected_client& registered) {
+				registered.authenticated = true;
+			});
+
+			log(log_record(LOG_INFO, EVENT_AUTH_SUCCEEDED).from(client.sock_info).with_socket(client.socket));
 		} else {
-			packet_to_send = form_packet("", -1, SERVERDATA_AUTH_RESPONSE);
-			on_log("Client [" + std::string(inet_ntoa(client.sock_info.sin_addr)) + ":" + std::to_string(ntohs(client.sock_info.sin_port)) + "] failed authentication!");
+			queue_packet(conn, "", -1, SERVERDATA_AUTH_RESPONSE);
+			counters.auth_failures.add();
+			log(log_record(LOG_WARNING, EVENT_AUTH_FAILED).from(client.sock_info).with_socket(client.socket));
 
 			client.authentication_attempts++;
 
 			// Client has attempted too many authentication attempts, we should now remove them.
 			if (client.authentication_attempts >= MAX_AUTHENTICATION_ATTEMPTS) {
-				on_log("Client [" + std::string(inet_ntoa(client.sock_info.sin_addr)) + ":" + std::to_string(ntohs(client.sock_info.sin_port)) + "] has attempted too many authentication attempts!");
-				disconnect_client(client.socket);
+				log(log_record(LOG_WARNING, EVENT_AUTH_ATTEMPTS_EXCEEDED).from(client.sock_info).with_socket(client.socket));
+				client.connected = false;
+			}
+		}
+
+		return;
+	}
+
+	if (type == SERVERDATA_RESPONSE_VALUE) {
+		/*
+		 * Clients send an empty SERVERDATA_RESPONSE_VALUE after a command to find out where a multi-packet response ends.
+		 * Like Source servers, we mirror it back, but only once every response before it has been sent.
+		 */
+		if (conn.responses_pending > 0) {
+			conn.deferred_terminators.push_back(id);
+			return;
+		}
+
+		queue_packet(conn, "", id, SERVERDATA_RESPONSE_VALUE);
+		return;
+	}
+
+	if (type != SERVERDATA_EXECCOMMAND) {
+		queue_packet(conn, "Invalid packet type (" + std::to_string(type) + "). Double check your packets.", id, SERVERDATA_RESPONSE_VALUE);
+		log(log_record(LOG_WARNING, EVENT_INVALID_PACKET_TYPE).from(client.sock_info).with_socket(client.socket).with_id(type));
+		return;
+	}
+
+	log(log_record(LOG_DEBUG, EVENT_COMMAND_RECEIVED).from(client.sock_info).with_socket(client.socket).with_id(id).with_text(body));
+
+	if (!on_command && !on_command_async && !on_command_view && commands.empty()) {
+		log(log_record(LOG_WARNING, EVENT_NO_COMMAND_HANDLER).from(client.sock_info).with_socket(client.socket).with_id(id));
+
+		/*
+		 * Whilst sending information about the server not responding would be nice,
+		 * we would end up with the possibility of clients thinking that is the response.
+		 * It's better to just send no information and let clients assume that meant
+		 * the server didn't like the command.
+		 */
+		queue_packet(conn, "", id, SERVERDATA_RESPONSE_VALUE);
+		return;
+	}
+
+	const auto received_at = std::chrono::steady_clock::now();
+
+	// Answered right here, and nothing is waiting to be answered before it, so the response can be queued without a responder.
+	if (!command_handlers && !on_command_async && conn.responses_pending == 0) {
+		send_response(conn, id, run_command(command_view(body, client)));
+		counters.request_time.record(std::chrono::steady_clock::now() - received_at);
+		return;
+	}
+
+	const command_responder responder = make_responder(conn_ptr, id, received_at);
+
+	// The receive buffer is reused once we return, so a command that may be answered later needs its own copy.
+	client_command command{ client, std::string(body) };
+
+	if (!command_handlers) {
+		dispatch_command(command, responder);
+		return;
+	}
+
+	const bool queued = command_handlers->submit([this, command = std::move(command), responder]() {
+		dispatch_command(command, responder);
+	});
+
+	if (!queued) {
+		log(log_record(LOG_WARNING, EVENT_HANDLER_QUEUE_FULL).from(client.sock_info).with_socket(client.socket).with_id(id));
+		responder.respond("");
+	}
+}
+
+rconpp::command_responder rconpp::rcon_server::make_responder(const std::shared_ptr<connection>& conn, const int32_t id, const std::chrono::steady_clock::time_point received_at) {
+	command_responder responder{};
+	responder.shared = std::make_shared<command_responder::state>();
+
+	// The responder can outlive the client, so it only holds on to it weakly.
+	std::weak_ptr<connection> weak_conn = conn;
+	io_loop* owner = conn->owner;
+
+	conn->responses_pending++;
+
+	responder.shared->deliver = [this, guard = responders, weak_conn, owner, id, received_at](std::string&& text_to_send) {
+		// Held until we're done with the server (and `owner`), so it can't be destroyed part way through.
+		std::shared_lock lock(guard->mutex);
+
+		if (!guard->alive) {
+			return;
+		}
+
+		if (owner->events.in_loop_thread()) {
+			const std::shared_ptr<connection> target = weak_conn.lock();
+
+			if (!target || !target->info.connected) {
+				return;
+			}
+
+			send_response(*target, id, std::move(text_to_send));
+			finish_response(*target);
+			counters.request_time.record(std::chrono::steady_clock::now() - received_at);
+
+			// We're answering while the client's packets are being read, which will flush once every packet has been handled.
+			if (target->reading) {
 				return;
 			}
+
+			if (!flush(*target)) {
+				close_connection(*owner, target->info.socket);
+			}
+
+			return;
 		}
-	} else {
-		if (type != SERVERDATA_EXECCOMMAND) {
-			packet_to_send = form_packet("Invalid packet type (" + std::to_string(type) + "). Double check your packets.", id, SERVERDATA_RESPONSE_VALUE);
-			on_log("Invalid packet type (" + std::to_string(type) + ") sent by [" + inet_ntoa(client.sock_info.sin_addr) + ":" + std::to_string(ntohs(client.sock_info.sin_port)) + "]. Asking client to double check their packets.");
-		} else {
-			on_log("Client [" + std::string(inet_ntoa(client.sock_info.sin_addr)) + ":" + std::to_string(ntohs(client.sock_info.sin_port)) + "] has asked to execute the command: \"" + packet_data + "\"");
-			if (!on_command) {
-				on_log("You have not set any response for on_command! The server will default to a blank response.");
-
-				/*
-				 * Whilst sending information about the server not responding would be nice,
-				 * we would end up with the possibility of clients thinking that is the response.
-				 * It's better to just send no information and let clients assume that meant
-				 * the server didn't like the command.
-				 */
-				packet_to_send = form_packet("", id, SERVERDATA_RESPONSE_VALUE);
-			} else {
-				client_command command{};
-				command.command = packet_data;
-				command.client = client;
-
-				std::string text_to_send = on_command(command);
-
-				on_log("Sending reply \"" + text_to_send + "\" to client [" + std::string(inet_ntoa(client.sock_info.sin_addr)) + ":" + std::to_string(ntohs(client.sock_info.sin_port)) + "].");
-
-				packet_to_send = form_packet(text_to_send, id, SERVERDATA_RESPONSE_VALUE);
+
+		owner->events.post([this, weak_conn, owner, id, received_at, text_to_send = std::move(text_to_send)]() mutable {
+			const std::shared_ptr<connection> target = weak_conn.lock();
+
+			if (!target || !target->info.connected) {
+				return;
+			}
+
+			send_response(*target, id, std::move(text_to_send));
+			finish_response(*target);
+			counters.request_time.record(std::chrono::steady_clock::now() - received_at);
+
+			if (!flush(*target)) {
+				target->info.connected = false;
 			}
+
+			if (!target->info.connected) {
+				close_connection(*owner, target->info.socket);
+			}
+		});
+	};
+
+	return responder;
+}
+
+std::string rconpp::rcon_server::run_command(const command_view& command) {
+	const auto started = std::chrono::steady_clock::now();
+	std::string response{};
+
+	// Without any verbs, every command would be counted as unrouted on its way to the handlers below.
+	if (commands.empty() || !commands.dispatch(command, response)) {
+		if (on_command_view) {
+			response = on_command_view(command);
+		} else if (on_command) {
+			response = on_command(command.to_command());
 		}
 	}
 
-	on_log("Sending packet (of size: " + std::to_string(packet_to_send.length) + ") to client [" + std::string(inet_ntoa(client.sock_info.sin_addr)) + ":" + std::to_string(ntohs(client.sock_info.sin_port)) + "]");
+	counters.handler_time.record(std::chrono::steady_clock::now() - started);
 
-	if (send(client.socket, packet_to_send.data.data(), packet_to_send.length, MSG_NOSIGNAL) < 0) {
-		const last_error err = get_last_error();
-		on_log("Failed to send a packet to Client [" + std::string(inet_ntoa(client.sock_info.sin_addr)) + ":" + std::to_string(ntohs(client.sock_info.sin_port)) + " | Error code: " + std::to_string(err.error_code) + "]!");
+	return response;
+}
+
+void rconpp::rcon_server::dispatch_command(const client_command& command, const command_responder& responder) {
+	const auto started = std::chrono::steady_clock::now();
+	std::string response{};
 
-		// Since the client looks to have disconnected, we need to check their heartbeat immediately.
-		if (err.type_of_error == DISCONNECTED) {
-			client.last_heartbeat = 0;
+	if (commands.empty() || !commands.dispatch(command_view(command.command, command.client), response)) {
+		if (on_command_async) {
+			// Only the hand off is timed here, the rest shows up in `request_time` once it's answered.
+			on_command_async(command, responder);
+			counters.handler_time.record(std::chrono::steady_clock::now() - started);
+			return;
+		}
+
+		if (on_command_view) {
+			response = on_command_view(command_view(command.command, command.client));
+		} else if (on_command) {
+			response = on_command(command);
 		}
 	}
+
+	counters.handler_time.record(std::chrono::steady_clock::now() - started);
+
+	responder.respond(std::move(response));
 }
 
-bool rconpp::rcon_server::send_heartbeat(connected_client& client) {
-	on_log("Sending heartbeat to Client [" + std::string(inet_ntoa(client.sock_info.sin_addr)) + ":" + std::to_string(ntohs(client.sock_info.sin_port)) + "]");
+void rconpp::rcon_server::send_response(connection& conn, const int32_t id, std::string text_to_send) {
+	const connected_client& client = conn.info;
 
-	packet packet_to_send = form_packet("", -1, SERVERDATA_RESPONSE_VALUE);
-	if (send(client.socket, packet_to_send.data.data(), packet_to_send.length, MSG_NOSIGNAL) < 0) {
-		const last_error err = get_last_error();
-		on_log("Failed to send a heartbeat to Client [" + std::string(inet_ntoa(client.sock_info.sin_addr)) + ":" + std::to_string(ntohs(client.sock_info.sin_port)) + " | Error code: " + std::to_string(err.error_code) + "]!");
-		return false;
+	const size_t body_limit = static_cast<size_t>(std::max(max_packet_size.load(), MIN_PACKET_SIZE + 1) - MIN_PACKET_SIZE);
+
+	// Most responses fit in one packet, and copying them is cheaper than sharing them.
+	if (text_to_send.size() <= body_limit) {
+		log(log_record(LOG_DEBUG, EVENT_RESPONSE_SENT).from(client.sock_info).with_socket(client.socket).with_id(id).with_size(1).with_text(text_to_send));
+
+		write_packet_header(conn, id, SERVERDATA_RESPONSE_VALUE, text_to_send.size());
+		queue_bytes(conn, text_to_send.data(), text_to_send.size());
+		queue_bytes(conn, PACKET_TERMINATOR, sizeof(PACKET_TERMINATOR));
+		return;
 	}
 
-	client.last_heartbeat = time(nullptr);
+	// Bigger responses are split up, with every packet's body pointing straight into the one response string.
+	const auto response = std::make_shared<const std::string>(std::move(text_to_send));
+	const size_t packet_count = (response->size() + body_limit - 1) / body_limit;
+
+	log(log_record(LOG_DEBUG, EVENT_RESPONSE_SENT).from(client.sock_info).with_socket(client.socket).with_id(id).with_size(packet_count).with_text(*response));
+
+	for (size_t offset = 0; offset < response->size(); offset += body_limit) {
+		const size_t body_size = std::min(body_limit, response->size() - offset);
+
+		write_packet_header(conn, id, SERVERDATA_RESPONSE_VALUE, body_size);
+		queue_shared(conn, response, offset, body_size);
+		queue_bytes(conn, PACKET_TERMINATOR, sizeof(PACKET_TERMINATOR));
+	}
+}
+
+void rconpp::rcon_server::finish_response(connection& conn) {
+	if (conn.responses_pending > 0) {
+		conn.responses_pending--;
+	}
+
+	if (conn.responses_pending > 0) {
+		return;
+	}
+
+	// Every response has been queued, so any terminators the client sent can now be mirrored back.
+	for (const int32_t terminator_id : conn.deferred_terminators) {
+		write_packet_header(conn, terminator_id, SERVERDATA_RESPONSE_VALUE, 0);
+		queue_bytes(conn, PACKET_TERMINATOR, sizeof(PACKET_TERMINATOR));
+	}
+
+	conn.deferred_terminators.clear();
+}
+
+void rconpp::rcon_server::write_packet_header(connection& conn, const int32_t id, const int32_t type, const size_t body_size) {
+	char header[PACKET_HEADER_LENGTH];
+	encode_packet_header(header, id, type, body_size);
+
+	counters.packets_out.add();
+
+	queue_bytes(conn, header, sizeof(header));
+}
+
+void rconpp::rcon_server::queue_packet(connection& conn, const std::string_view body, const int32_t id, const int32_t type) {
+	// Encoded straight into the write buffer, which keeps its capacity between flushes.
+	const size_t offset = conn.write_buffer.size();
+	append_packet(conn.write_buffer, body, id, type);
+	counters.packets_out.add();
+
+	add_segment(conn, offset, packet_length(body.size()));
+}
+
+void rconpp::rcon_server::queue_bytes(connection& conn, const char* data, const size_t size) {
+	if (size == 0) {
+		return;
+	}
+
+	const size_t offset = conn.write_buffer.size();
+	conn.write_buffer.insert(conn.write_buffer.end(), data, data + size);
+
+	add_segment(conn, offset, size);
+}
+
+void rconpp::rcon_server::add_segment(connection& conn, const size_t offset, const size_t size) {
+	conn.pending_bytes += size;
+
+	// Bytes copied back to back can go out as one segment.
+	if (!conn.write_queue.empty()) {
+		connection::write_segment& last = conn.write_queue.back();
+
+		if (!last.shared && last.offset + last.size == offset) {
+			last.size += size;
+			return;
+		}
+	}
+
+	conn.write_queue.push_back({ nullptr, offset, size });
+}
+
+void rconpp::rcon_server::queue_shared(connection& conn, const std::shared_ptr<const std::string>& buffer, const size_t offset, const size_t size) {
+	if (size == 0) {
+		return;
+	}
+
+	conn.pending_bytes += size;
+	conn.write_queue.push_back({ buffer, offset, size });
+}
+
+void rconpp::rcon_server::deliver_broadcast(io_loop& loop, const std::shared_ptr<const std::string>& encoded, const size_t packet_count, const std::vector<std::pair<SOCKET_TYPE, uint64_t>>& targets) {
+	const size_t pending_limit = max_pending_bytes.load(std::memory_order_relaxed);
+
+	for (const auto& [client_socket, client_id] : targets) {
+		// Only the loop that owns the socket will find it, the others skip it.
+		auto found = loop.connections.find(client_socket);
+
+		if (found == loop.connections.end()) {
+			continue;
+		}
+
+		const std::shared_ptr<connection> conn = found->second;
+		connected_client& client = conn->info;
+
+		if (client.id != client_id || !client.connected || !client.authenticated) {
+			continue;
+		}
+
+		// This client isn't reading what it's already been sent. Leave it behind rather than queueing more for it.
+		if (conn->pending_bytes + encoded->size() > pending_limit) {
+			counters.broadcasts_dropped.add();
+			log(log_record(LOG_DEBUG, EVENT_BROADCAST_DROPPED).from(client.sock_info).with_socket(client_socket).with_size(conn->pending_bytes));
+			continue;
+		}
+
+		queue_shared(*conn, encoded, 0, encoded->size());
+		counters.packets_out.add(packet_count);
+		counters.broadcasts_sent.add();
+
+		if (!flush(*conn)) {
+			client.connected = false;
+		}
+
+		if (!client.connected) {
+			close_connection(loop, client_socket);
+		}
+	}
+}
+
+bool rconpp::rcon_server::flush(connection& conn) {
+	connected_client& client = conn.info;
+
+	while (conn.write_head < conn.write_queue.size()) {
+#ifdef _WIN32
+		WSABUF buffers[MAX_WRITE_SEGMENTS];
+#else
+		iovec buffers[MAX_WRITE_SEGMENTS];
+#endif
+		size_t buffer_count = 0;
+
+		for (size_t i = conn.write_head; i < conn.write_queue.size() && buffer_count < MAX_WRITE_SEGMENTS; i++, buffer_count++) {
+			const connection::write_segment& segment = conn.write_queue[i];
+
+			const char* data = segment.shared ? segment.shared->data() + segment.offset : conn.write_buffer.data() + segment.offset;
+			size_t size = segment.size;
+
+			if (i == conn.write_head) {
+				data += conn.write_offset;
+				size -= conn.write_offset;
+			}
+
+#ifdef _WIN32
+			buffers[buffer_count].buf = const_cast<char*>(data);
+			buffers[buffer_count].len = static_cast<ULONG>(size);
+#else
+			buffers[buffer_count].iov_base = const_cast<char*>(data);
+			buffers[buffer_count].iov_len = size;
+#endif
+		}
+
+#ifdef _WIN32
+		DWORD sent_bytes = 0;
+		const int64_t sent = WSASend(client.socket, buffers, static_cast<DWORD>(buffer_count), &sent_bytes, 0, nullptr, nullptr) == 0 ? static_cast<int64_t>(sent_bytes) : -1;
+#else
+		msghdr message{};
+		message.msg_iov = buffers;
+		message.msg_iovlen = buffer_count;
+		const int64_t sent = sendmsg(client.socket, &message, MSG_NOSIGNAL);
+#endif
+
+		if (sent < 0) {
+			const last_error err = get_last_error();
+
+			if (err.type_of_error == WOULD_BLOCK) {
+				// The client isn't keeping up, wait until the socket tells us it can take more.
+				conn.owner->events.modify(client.socket, IO_READABLE | IO_WRITABLE);
+				return true;
+			}
+
+			log(log_record(LOG_WARNING, EVENT_SEND_FAILED).from(client.sock_info).with_socket(client.socket).with_error(err.error_code));
+			return false;
+		}
+
+		counters.bytes_out.add(static_cast<uint64_t>(sent));
+
+		conn.pending_bytes -= std::min(conn.pending_bytes, static_cast<size_t>(sent));
+
+		// Move past everything that was sent, which may end part way through a segment.
+		size_t remaining = static_cast<size_t>(sent);
+
+		while (remaining > 0) {
+			connection::write_segment& segment = conn.write_queue[conn.write_head];
+			const size_t left_in_segment = segment.size - conn.write_offset;
+
+			if (remaining < left_in_segment) {
+				conn.write_offset += remaining;
+				break;
+			}
+
+			remaining -= left_in_segment;
+			segment.shared.reset();
+			conn.write_head++;
+			conn.write_offset = 0;
+		}
+	}
+
+	// Keep the capacity around, the next response can reuse it.
+	conn.pending_bytes = 0;
+	conn.write_buffer.clear();
+	conn.write_queue.clear();
+	conn.write_head = 0;
+	conn.write_offset = 0;
+	conn.owner->events.modify(client.socket, IO_READABLE);
 
 	return true;
 }
 
-void rconpp::rcon_server::client_process_loop(connected_client& client) {
-	while (client.connected) {
-		read_packet(client);
+void rconpp::rcon_server::send_heartbeat(connection& conn) {
+	connected_client& client = conn.info;
 
-		const time_t current_time = time(nullptr);
+	log(log_record(LOG_DEBUG, EVENT_HEARTBEAT_SENT).from(client.sock_info).with_socket(client.socket));
 
-		if (client.last_heartbeat == 0 || current_time - client.last_heartbeat >= HEARTBEAT_TIME) {
-			if (!send_heartbeat(client)) {
-				on_log("Client [" + std::string(inet_ntoa(client.sock_info.sin_addr)) + ":" + std::to_string(ntohs(client.sock_info.sin_port)) + " | Socket: " + std::to_string(client.socket) + "] is now being disconnected.");
-				disconnect_client(client.socket);
-				// disconnect_client should do this, but we'll do it too.
-				client.connected = false;
+	client.last_heartbeat = time(nullptr);
+	conn.last_heartbeat = std::chrono::steady_clock::now();
+
+	queue_packet(conn, "", -1, SERVERDATA_RESPONSE_VALUE);
+	counters.heartbeats_sent.add();
+
+	if (!flush(conn)) {
+		client.connected = false;
+	}
+
+	if (!client.connected) {
+		log(log_record(LOG_WARNING, EVENT_HEARTBEAT_FAILED).from(client.sock_info).with_socket(client.socket));
+	}
+}
+
+void rconpp::rcon_server::check_timers(io_loop& loop, const std::shared_ptr<connection>& conn) {
+	connected_client& client = conn->info;
+
+	const auto now = std::chrono::steady_clock::now();
+	auto next_due = std::chrono::steady_clock::time_point::max();
+
+	if (!client.authenticated && auth_timeout.count() > 0) {
+		const auto deadline = conn->connected_at + auth_timeout;
+
+		if (now >= deadline) {
+			counters.auth_timeouts.add();
+			log(log_record(LOG_WARNING, EVENT_AUTH_TIMED_OUT).from(client.sock_info).with_socket(client.socket));
+			close_connection(loop, client.socket);
+			return;
+		}
+
+		next_due = std::min(next_due, deadline);
+	}
+
+	if (idle_timeout.count() > 0) {
+		const auto deadline = conn->last_received + idle_timeout;
+
+		if (now >= deadline) {
+			counters.idle_timeouts.add();
+			log(log_record(LOG_INFO, EVENT_CLIENT_IDLE).from(client.sock_info).with_socket(client.socket));
+			close_connection(loop, client.socket);
+			return;
+		}
+
+		next_due = std::min(next_due, deadline);
+	}
+
+	if (heartbeat_interval.count() > 0) {
+		auto heartbeat_due = std::max(conn->last_received, conn->last_heartbeat) + heartbeat_interval;
+
+		if (now >= heartbeat_due) {
+			send_heartbeat(*conn);
+
+			if (!client.connected) {
+				log(log_record(LOG_DEBUG, EVENT_CLIENT_DROPPED).from(client.sock_info).with_socket(client.socket));
+				close_connection(loop, client.socket);
+				return;
 			}
+
+			heartbeat_due = conn->last_heartbeat + heartbeat_interval;
 		}
 
-		// No need to let the server keep running this causing 100% usage on a thread, we can wait a bit between requests.
-		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		next_due = std::min(next_due, heartbeat_due);
+	}
+
+	// Packets coming in don't touch the timer, they only move `last_received`. A timer that fires early just works out when it's next due.
+	if (next_due != std::chrono::steady_clock::time_point::max()) {
+		loop.timers.schedule(conn->timer, next_due);
 	}
 }
 
@@ -271,67 +932,106 @@ void rconpp::rcon_server::start(bool return_after) {
 	};
 
 	if (port > 65535) {
-		on_log("Invalid port! The port can't exceed 65535!");
+		log(log_record(LOG_ERROR, EVENT_INVALID_PORT));
 		return;
 	}
 
-	on_log("Attempting to startup an RCON server...");
+	log(log_record(LOG_INFO, EVENT_SERVER_STARTING));
 
 	if (!startup_server()) {
-		on_log("RCON server is aborting as it failed to initiate server.");
+		log(log_record(LOG_ERROR, EVENT_SERVER_START_FAILED));
 		return;
 	}
 
 	online = true;
 
-	on_log("Server is now listening, initiating runners...");
-
-	accept_connections_runner = std::thread([this]() {
-		while (online) {
-			sockaddr_in client_info{};
-
-			socklen_t client_len = sizeof(client_info);
-			SOCKET_TYPE client_socket = accept(sock, reinterpret_cast<sockaddr*>(&client_info), &client_len);
-
-			if (client_socket == INVALID_SOCKET) {
-				const last_error err = get_last_error();
-				on_log("A new client attempted to join but failed [Error code: " + std::to_string(err.error_code) + "]!");
-				continue;
-			}
-
-			on_log("Client [" + std::string(inet_ntoa(client_info.sin_addr)) + ":" + std::to_string(ntohs(client_info.sin_port)) + " | Socket: " + std::to_string(client_socket) + "] is connecting to the server.");
-
-			connected_client client{};
-
-			client.sock_info = client_info;
-			client.socket = client_socket;
-			client.connected = true;
-			// We don't want to send a heartbeat instantly and confuse clients.
-			client.last_heartbeat = time(nullptr);
+	log(log_record(LOG_INFO, EVENT_SERVER_LISTENING));
 
-			add_client(client_socket, client);
-
-			std::thread client_thread(&rcon_server::client_process_loop, this, std::ref(connected_clients.at(client_socket)));
+	if (handler_threads > 0) {
+		command_handlers = std::make_unique<thread_pool>(handler_threads, handler_queue_size, pin_handler_threads);
+	}
 
-			while (!request_handlers_mutex.try_lock()) {
-				std::this_thread::sleep_for(std::chrono::milliseconds(100));
-			}
+	const unsigned int loop_count = std::max(1u, io_threads);
 
-			request_handlers.insert({ client_socket, std::move(client_thread) });
+	for (unsigned int i = 0; i < loop_count; i++) {
+		auto loop = std::make_unique<io_loop>();
+		io_loop* loop_ptr = loop.get();
+		loop->server = this;
 
-			request_handlers.at(client_socket).detach();
+		// The loop only wakes when a timer is due. The hourly tick is a backstop, and does nothing if no timer is.
+		loop->events.set_tick(std::chrono::hours(1), [loop_ptr]() {
+			loop_ptr->timers.advance();
+			loop_ptr->events.tick_before(loop_ptr->timers.next_expiry());
+		});
 
-			request_handlers_mutex.unlock();
+		loops.emplace_back(std::move(loop));
+	}
 
-			on_log("Client [" + std::string(inet_ntoa(client_info.sin_addr)) + ":" + std::to_string(ntohs(client_info.sin_port)) + " | Socket: " + std::to_string(client_socket) + "] has successfully connected to the server, asking for authentication.");
-		}
+	// The first loop also accepts new clients.
+	loops.front()->events.add(sock, IO_READABLE, [this](uint32_t) {
+		accept_clients();
 	});
 
-	accept_connections_runner.detach();
+	for (auto& loop : loops) {
+		io_loop* loop_ptr = loop.get();
+		loop->runner = std::thread([loop_ptr]() {
+			loop_ptr->events.run();
+		});
+	}
 
-	on_log("Server is now ready!");
+	log(log_record(LOG_INFO, EVENT_SERVER_READY));
 
 	if (!return_after) {
 		block_calling_thread();
 	}
 }
+
+rconpp::server_metrics rconpp::rcon_server::metrics() const {
+	server_metrics result{};
+
+	result.connections_accepted = counters.connections_accepted.load();
+	result.connections_closed = counters.connections_closed.load();
+	result.auth_successes = counters.auth_successes.load();
+	result.auth_failures = counters.auth_failures.load();
+	result.packets_in = counters.packets_in.load();
+	result.packets_out = counters.packets_out.load();
+	result.bytes_in = counters.bytes_in.load();
+	result.bytes_out = counters.bytes_out.load();
+	result.heartbeats_sent = counters.heartbeats_sent.load();
+	result.broadcasts_sent = counters.broadcasts_sent.load();
+	result.broadcasts_dropped = counters.broadcasts_dropped.load();
+	result.auth_timeouts = counters.auth_timeouts.load();
+	result.idle_timeouts = counters.idle_timeouts.load();
+	result.handler_time = counters.handler_time.snapshot();
+	result.request_time = counters.request_time.snapshot();
+	result.verbs = commands.stats();
+
+	return result;
+}
+
+std::string rconpp::server_metrics::to_text() const {
+	metrics_writer writer{};
+
+	writer.counter("rconpp_server_connections_accepted", "Clients that have connected.", connections_accepted);
+	writer.counter("rconpp_server_connections_closed", "Clients that have disconnected, or been disconnected.", connections_closed);
+	writer.counter("rconpp_server_auth_successes", "Logins with the right password.", auth_successes);
+	writer.counter("rconpp_server_auth_failures", "Logins with the wrong password.", auth_failures);
+	writer.counter("rconpp_server_packets_in", "Packets received from clients.", packets_in);
+	writer.counter("rconpp_server_packets_out", "Packets queued to clients.", packets_out);
+	writer.counter("rconpp_server_bytes_in", "Bytes received from clients.", bytes_in);
+	writer.counter("rconpp_server_bytes_out", "Bytes sent to clients.", bytes_out);
+	writer.counter("rconpp_server_heartbeats_sent", "Heartbeats sent to quiet clients.", heartbeats_sent);
+	writer.counter("rconpp_server_broadcasts_sent", "Broadcasts queued to clients.", broadcasts_sent);
+	writer.counter("rconpp_server_broadcasts_dropped", "Broadcasts skipped for clients with too much waiting to be sent.", broadcasts_dropped);
+	writer.counter("rconpp_server_auth_timeouts", "Clients disconnected for not logging in in time.", auth_timeouts);
+	writer.counter("rconpp_server_idle_timeouts", "Clients disconnected for not sending anything in time.", idle_timeouts);
+
+	writer.histogram("rconpp_server_handler_seconds", "How long command handlers took.", "", handler_time);
+	writer.histogram("rconpp_server_request_seconds", "How long commands took from being received to being answered.", "", request_time);
+
+	for (size_t i = 0; i < verbs.size(); i++) {
+		writer.histogram("rconpp_server_verb_handler_seconds", "How long each verb's handler took.", metrics_writer::label("verb", verbs[i].verb), verbs[i].latency, i == 0);
+	}
+
+	return writer.str();
+}
@@ -0,0 +1,99 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+void pin_to_core(std::thread& thread, const unsigned int core) {
+#ifdef _WIN32
+	SetThreadAffinityMask(thread.native_handle(), static_cast<DWORD_PTR>(1) << core);
+#elif defined(__linux__)
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	CPU_SET(core, &cpu_set);
+	pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set), &cpu_set);
+#else
+	(void)thread;
+	(void)core;
+#endif
+}
+
+} // namespace
+
+rconpp::thread_pool::thread_pool(const unsigned int threads, const size_t queue_size, const bool pin_threads) : max_queued(std::max<size_t>(1, queue_size)) {
+	const unsigned int thread_count = std::max(1u, threads);
+	const unsigned int core_count = std::max(1u, std::thread::hardware_concurrency());
+
+	workers.reserve(thread_count);
+
+	for (unsigned int i = 0; i < thread_count; i++) {
+		workers.emplace_back(&thread_pool::worker_loop, this);
+
+		if (pin_threads) {
+			pin_to_core(workers.back(), i % core_count);
+		}
+	}
+}
+
+rconpp::thread_pool::~thread_pool() {
+	stop();
+}
+
+void rconpp::thread_pool::stop() {
+	{
+		std::lock_guard lock(tasks_mutex);
+		stopping = true;
+		tasks.clear();
+	}
+
+	tasks_ready.notify_all();
+
+	for (auto& worker : workers) {
+		if (worker.joinable()) {
+			worker.join();
+		}
+	}
+}
+
+bool rconpp::thread_pool::submit(std::function<void()> task) {
+	{
+		std::lock_guard lock(tasks_mutex);
+
+		if (stopping || tasks.size() >= max_queued) {
+			return false;
+		}
+
+		tasks.emplace_back(std::move(task));
+	}
+
+	tasks_ready.notify_one();
+
+	return true;
+}
+
+void rconpp::thread_pool::worker_loop() {
+	while (true) {
+		std::function<void()> task;
+
+		{
+			std::unique_lock lock(tasks_mutex);
+			tasks_ready.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+			if (stopping) {
+				return;
+			}
+
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+
+		task();
+	}
+}
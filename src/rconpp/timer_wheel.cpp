@@ -0,0 +1,215 @@
+#include <algorithm>
+#include "timer_wheel.h"
+
+namespace {
+
+constexpr uint64_t SLOT_MASK = rconpp::timer_wheel::SLOTS - 1;
+
+/**
+ * @returns How many ticks one slot on `level` covers.
+ */
+constexpr uint64_t level_span(const size_t level) {
+	return uint64_t(1) << (rconpp::timer_wheel::SLOT_BITS * level);
+}
+
+} // namespace
+
+rconpp::timer_wheel::timer::~timer() {
+	if (wheel) {
+		wheel->cancel(*this);
+	}
+}
+
+rconpp::timer_wheel::timer_wheel(const std::chrono::milliseconds _resolution, const clock::time_point start) : resolution(std::max(_resolution, std::chrono::milliseconds(1))), origin(start) {}
+
+rconpp::timer_wheel::~timer_wheel() {
+	// Anything still scheduled is let go of, so it doesn't try to take itself off a wheel that's gone.
+	for (auto& level : levels) {
+		for (timer*& head : level) {
+			while (head) {
+				timer* entry = head;
+				head = entry->next;
+
+				entry->wheel = nullptr;
+				entry->previous = nullptr;
+				entry->next = nullptr;
+				entry->bucket = nullptr;
+			}
+		}
+	}
+}
+
+uint64_t rconpp::timer_wheel::tick_of(const clock::time_point when) const {
+	if (when <= origin) {
+		return 0;
+	}
+
+	const auto elapsed = std::chrono::ceil<std::chrono::milliseconds>(when - origin);
+
+	return static_cast<uint64_t>((elapsed.count() + resolution.count() - 1) / resolution.count());
+}
+
+void rconpp::timer_wheel::link(timer& entry) {
+	const uint64_t delta = entry.expires - current;
+	size_t level = 0;
+
+	while (level + 1 < LEVELS && delta >= level_span(level + 1)) {
+		level++;
+	}
+
+	timer*& head = levels[level][(entry.expires >> (SLOT_BITS * level)) & SLOT_MASK];
+
+	entry.previous = nullptr;
+	entry.next = head;
+
+	if (head) {
+		head->previous = &entry;
+	}
+
+	head = &entry;
+	entry.bucket = &head;
+	entry.level = level;
+	level_counts[level]++;
+}
+
+void rconpp::timer_wheel::unlink(timer& entry) {
+	if (entry.previous) {
+		entry.previous->next = entry.next;
+	} else {
+		*entry.bucket = entry.next;
+	}
+
+	if (entry.next) {
+		entry.next->previous = entry.previous;
+	}
+
+	level_counts[entry.level]--;
+
+	entry.previous = nullptr;
+	entry.next = nullptr;
+	entry.bucket = nullptr;
+}
+
+void rconpp::timer_wheel::schedule(timer& entry, const clock::time_point when) {
+	if (entry.wheel) {
+		entry.wheel->cancel(entry);
+	}
+
+	const uint64_t tick = tick_of(when);
+
+	// Nothing is ever put in the slot being fired, so a timer scheduled from a callback can't fire in the same call to `advance`.
+	if (tick <= current) {
+		entry.expires = current + 1;
+	} else if (tick - current > MAX_TICKS) {
+		entry.expires = current + MAX_TICKS;
+	} else {
+		entry.expires = tick;
+	}
+
+	entry.wheel = this;
+	link(entry);
+	count++;
+}
+
+void rconpp::timer_wheel::cancel(timer& entry) {
+	if (entry.wheel != this) {
+		return;
+	}
+
+	unlink(entry);
+	entry.wheel = nullptr;
+	count--;
+}
+
+void rconpp::timer_wheel::cascade(const size_t level, const size_t index) {
+	timer* entry = levels[level][index];
+	levels[level][index] = nullptr;
+
+	while (entry) {
+		timer* following = entry->next;
+
+		level_counts[level]--;
+		link(*entry);
+
+		entry = following;
+	}
+}
+
+size_t rconpp::timer_wheel::advance(const clock::time_point now) {
+	const uint64_t target = now <= origin ? 0 : static_cast<uint64_t>((now - origin) / resolution);
+	size_t fired = 0;
+
+	while (current < target) {
+		if (count == 0) {
+			current = target;
+			break;
+		}
+
+		// With nothing on the first level, every tick up to the next cascade is empty.
+		if (level_counts[0] == 0 && ((current + 1) & SLOT_MASK) != 0) {
+			current = std::min(target, current | SLOT_MASK);
+			continue;
+		}
+
+		current++;
+
+		// Each time a level wraps round, the next slot up is moved down.
+		for (size_t level = 1; level < LEVELS && (current & (level_span(level) - 1)) == 0; level++) {
+			cascade(level, (current >> (SLOT_BITS * level)) & SLOT_MASK);
+		}
+
+		timer*& head = levels[0][current & SLOT_MASK];
+
+		while (head) {
+			timer& entry = *head;
+
+			// Taken before the call, as the callback is allowed to destroy the timer.
+			void (*callback)(void* context) = entry.callback;
+			void* context = entry.context;
+
+			cancel(entry);
+			fired++;
+
+			if (callback) {
+				callback(context);
+			}
+		}
+	}
+
+	return fired;
+}
+
+rconpp::timer_wheel::clock::time_point rconpp::timer_wheel::next_expiry() const {
+	if (count == 0) {
+		return clock::time_point::max();
+	}
+
+	uint64_t soonest = UINT64_MAX;
+
+	if (level_counts[0] > 0) {
+		for (uint64_t tick = current + 1; tick < current + SLOTS; tick++) {
+			if (levels[0][tick & SLOT_MASK]) {
+				soonest = tick;
+				break;
+			}
+		}
+	}
+
+	// Timers higher up are only known to be somewhere in their slot, so the wheel has to wake when the slot is moved down.
+	for (size_t level = 1; level < LEVELS; level++) {
+		if (level_counts[level] == 0) {
+			continue;
+		}
+
+		const uint64_t block = current >> (SLOT_BITS * level);
+
+		for (uint64_t ahead = 1; ahead <= SLOTS; ahead++) {
+			if (levels[level][(block + ahead) & SLOT_MASK]) {
+				soonest = std::min(soonest, (block + ahead) << (SLOT_BITS * level));
+				break;
+			}
+		}
+	}
+
+	return soonest == UINT64_MAX ? clock::time_point::max() : time_of(soonest);
+}
@@ -2,6 +2,13 @@
 
 #include <iostream>
 #include <cstring>
+#include <cerrno>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
 
 rconpp::packet rconpp::form_packet(const std::string_view data, const int32_t id, const int32_t type) {
 	const int32_t data_size = static_cast<int32_t>(data.size()) + MIN_PACKET_SIZE;
@@ -11,21 +18,53 @@ rconpp::packet rconpp::form_packet(const std::string_view data, const int32_t id
 		return {};
 	}
 
-	std::vector<char> temp_data(data_size + PACKET_SIZE_BYTES); // Create a vector that exactly the size of the packet length.
-
-	std::memcpy(temp_data.data() + 0, &data_size, sizeof(data_size)); // Copy size into it
-	std::memcpy(temp_data.data() + sizeof(data_size), &id, sizeof(id)); // Copy id into it
-	std::memcpy(temp_data.data() + sizeof(data_size) + sizeof(id), &type, sizeof(type)); // Copy type into it
-	std::memcpy(temp_data.data() + sizeof(data_size) + sizeof(id) + sizeof(type), data.data(), data.size()); // Copy data into it
-
 	packet temp_packet;
 	temp_packet.length = data_size + PACKET_SIZE_BYTES;
 	temp_packet.size = data_size;
-	temp_packet.data = temp_data;
+	temp_packet.data.resize(temp_packet.length); // Create a vector that exactly the size of the packet length.
+
+	encode_packet(temp_packet.data.data(), temp_packet.data.size(), data, id, type);
 
 	return temp_packet;
 }
 
+void rconpp::encode_packet_header(char* destination, const int32_t id, const int32_t type, const size_t body_size) {
+	const int32_t packet_size = static_cast<int32_t>(body_size) + MIN_PACKET_SIZE;
+
+	std::memcpy(destination, &packet_size, sizeof(packet_size)); // Copy size into it
+	std::memcpy(destination + PACKET_SIZE_BYTES, &id, sizeof(id)); // Copy id into it
+	std::memcpy(destination + PACKET_SIZE_BYTES + sizeof(id), &type, sizeof(type)); // Copy type into it
+}
+
+size_t rconpp::encode_packet(char* destination, const size_t capacity, const std::string_view data, const int32_t id, const int32_t type) {
+	const size_t length = packet_length(data.size());
+
+	if (length > capacity) {
+		return 0;
+	}
+
+	encode_packet_header(destination, id, type, data.size());
+
+	if (!data.empty()) {
+		std::memcpy(destination + PACKET_HEADER_LENGTH, data.data(), data.size()); // Copy data into it
+	}
+
+	// Both null bytes after the body.
+	destination[length - 2] = 0;
+	destination[length - 1] = 0;
+
+	return length;
+}
+
+void rconpp::append_packet(std::vector<char>& buffer, const std::string_view data, const int32_t id, const int32_t type) {
+	const size_t offset = buffer.size();
+	const size_t length = packet_length(data.size());
+
+	buffer.resize(offset + length);
+
+	encode_packet(buffer.data() + offset, length, data, id, type);
+}
+
 int rconpp::bit32_to_int(const std::vector<char>& buffer) {
 	return static_cast<int>(buffer[0] | buffer[1] << 8 | buffer[2] << 16 | buffer[3] << 24);
 }
@@ -54,6 +93,9 @@ rconpp::last_error rconpp::get_last_error() {
 		case WSAEINTR:
 			last_error_type = SHUTTING_DOWN;
 			break;
+		case WSAEWOULDBLOCK:
+			last_error_type = WOULD_BLOCK;
+			break;
 	}
 #else
 	switch (last_error_num) {
@@ -62,6 +104,13 @@ rconpp::last_error rconpp::get_last_error() {
 		case 104:
 			last_error_type = DISCONNECTED;
 			break;
+		case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+		case EWOULDBLOCK:
+#endif
+		case EINPROGRESS:
+			last_error_type = WOULD_BLOCK;
+			break;
 	}
 #endif
 
@@ -72,16 +121,72 @@ rconpp::last_error rconpp::get_last_error() {
 }
 
 int rconpp::read_packet_size(const SOCKET_TYPE socket) {
-	std::vector<char> buffer{};
-	buffer.resize(PACKET_SIZE_BYTES);
+	int32_t size{0};
 
 	/*
 	 * RCON gives the packet SIZE in the first four (4) bytes of each packet.
 	 * We simply just want to read that and then return it.
 	 */
-	if (recv(socket, buffer.data(), PACKET_SIZE_BYTES, MSG_NOSIGNAL) == -1) {
+	if (recv(socket, reinterpret_cast<char*>(&size), PACKET_SIZE_BYTES, MSG_NOSIGNAL) != PACKET_SIZE_BYTES) {
 		return -1;
 	}
 
-	return bit32_to_int(buffer);
+	return size;
+}
+
+bool rconpp::set_non_blocking(const SOCKET_TYPE socket, const bool enabled) {
+#ifdef _WIN32
+	u_long mode = enabled ? 1 : 0;
+	return ioctlsocket(socket, FIONBIO, &mode) == 0;
+#else
+	const int flags = fcntl(socket, F_GETFL, 0);
+
+	if (flags == -1) {
+		return false;
+	}
+
+	return fcntl(socket, F_SETFL, enabled ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK)) == 0;
+#endif
+}
+
+void rconpp::close_socket(const SOCKET_TYPE socket) {
+#ifdef _WIN32
+	closesocket(socket);
+#else
+	close(socket);
+#endif
+}
+
+bool rconpp::wait_for_socket(const SOCKET_TYPE socket, const bool for_writing, const std::chrono::steady_clock::time_point deadline) {
+	while (true) {
+		const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+
+		if (remaining.count() <= 0) {
+			return false;
+		}
+
+#ifdef _WIN32
+		WSAPOLLFD fd{ socket, static_cast<SHORT>(for_writing ? POLLOUT : POLLIN), 0 };
+		const int ready = WSAPoll(&fd, 1, static_cast<INT>(remaining.count()));
+#else
+		pollfd fd{ socket, static_cast<short>(for_writing ? POLLOUT : POLLIN), 0 };
+		const int ready = poll(&fd, 1, static_cast<int>(remaining.count()));
+#endif
+
+		if (ready > 0) {
+			return true;
+		}
+
+#ifndef _WIN32
+		// Interrupted by a signal, go back to waiting for whatever time is left.
+		if (ready < 0 && errno == EINTR) {
+			continue;
+		}
+#endif
+
+		// A failed poll is handed back as ready, so the caller's next call reports the real error.
+		if (ready < 0) {
+			return true;
+		}
+	}
 }
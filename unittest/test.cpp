@@ -1,7 +1,128 @@
 #include "../include/rconpp/rcon.h"
 
+#ifdef RCONPP_CORO
+/**
+ * @brief The smallest coroutine type we need to test with, it starts straight away and nobody waits on it.
+ */
+struct detached_task {
+	struct promise_type {
+		detached_task get_return_object() { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+detached_task run_coroutine_test(rconpp::rcon_client& client, std::promise<bool>& passed) {
+	const rconpp::response first = co_await client.execute("first");
+	const rconpp::response second = co_await client.execute("second");
+
+	passed.set_value(first.data == "echo first" && second.data == "echo second");
+}
+#endif
+
 int main() {
 
+	try {
+		std::cout << "Attempting Packet Encoding test..." << "\n";
+
+		static_assert(rconpp::packet_length(0) == rconpp::MIN_PACKET_LENGTH, "An empty packet should be the minimum length.");
+
+		char encoded[64];
+		const size_t written = rconpp::encode_packet(encoded, sizeof(encoded), "status", 7, rconpp::SERVERDATA_EXECCOMMAND);
+		const rconpp::packet formed = rconpp::form_packet("status", 7, rconpp::SERVERDATA_EXECCOMMAND);
+
+		if (written != rconpp::packet_length(6) || written != formed.data.size() || std::memcmp(encoded, formed.data.data(), written) != 0) {
+			throw std::logic_error("encode_packet and form_packet disagree.");
+		}
+
+		if (rconpp::encode_packet(encoded, 10, "status", 7, rconpp::SERVERDATA_EXECCOMMAND) != 0) {
+			throw std::logic_error("encode_packet wrote past the end of the buffer.");
+		}
+
+		std::cout << "Encoded packets match, Packet Encoding test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "Packet Encoding test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
+	try {
+		std::cout << "Attempting Packet Decoder test..." << "\n";
+
+		std::vector<char> stream{};
+		rconpp::append_packet(stream, "first", 1, rconpp::SERVERDATA_RESPONSE_VALUE);
+		rconpp::append_packet(stream, "", 2, rconpp::SERVERDATA_RESPONSE_VALUE);
+		rconpp::append_packet(stream, std::string(5000, 'x'), 3, rconpp::SERVERDATA_RESPONSE_VALUE);
+
+		rconpp::packet_decoder decoder{};
+		rconpp::decoded_packet packet{};
+		std::vector<std::string> bodies{};
+
+		// A byte at a time, the worst a socket can do to us.
+		for (const char byte : stream) {
+			decoder.feed(&byte, 1);
+
+			while (decoder.next(packet, rconpp::MAX_PACKET_SIZE * 2) == rconpp::DECODE_PACKET) {
+				bodies.emplace_back(packet.body);
+			}
+		}
+
+		if (bodies.size() != 3 || bodies[0] != "first" || !bodies[1].empty() || bodies[2] != std::string(5000, 'x') || decoder.buffered() != 0) {
+			throw std::logic_error("Packets split over many reads were not put back together.");
+		}
+
+		// A size no server would ever send, which must be refused before anything waits on (or allocates for) the rest of it.
+		const int32_t hostile_size = 0x7FFFFFFF;
+		decoder.feed(reinterpret_cast<const char*>(&hostile_size), sizeof(hostile_size));
+
+		if (decoder.next(packet, rconpp::MAX_PACKET_SIZE) != rconpp::DECODE_INVALID) {
+			throw std::logic_error("A packet size over the limit was accepted.");
+		}
+
+		std::cout << "Split packets decoded and bad sizes refused, Packet Decoder test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "Packet Decoder test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
+	try {
+		std::cout << "Attempting Buffer Pool test..." << "\n";
+
+		rconpp::buffer_pool pool{};
+
+		std::vector<char> first = pool.acquire();
+		const char* first_data = first.data();
+
+		if (first.capacity() < pool.slab() || !first.empty()) {
+			throw std::logic_error("A new buffer didn't have room for a slab.");
+		}
+
+		pool.release(std::move(first));
+
+		// The same memory should come straight back, without allocating.
+		std::vector<char> second = pool.acquire();
+
+		if (second.data() != first_data) {
+			throw std::logic_error("A released buffer wasn't reused.");
+		}
+
+		// A buffer that grew far past a slab isn't worth holding on to.
+		second.resize(pool.slab() * 8);
+		pool.release(std::move(second));
+
+		const rconpp::buffer_pool_stats stats = pool.stats();
+
+		if (stats.hits != 1 || stats.misses != 1 || stats.returned != 1 || stats.discarded != 1 || stats.pooled != 0 || stats.hit_rate() != 0.5) {
+			throw std::logic_error("The pool's counters are wrong.");
+		}
+
+		std::cout << "Buffers reused and counted, Buffer Pool test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "Buffer Pool test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
 	try {
 		std::cout << "Attempting invalid client setups..." << "\n";
 
@@ -74,6 +195,1431 @@ int main() {
 		return -1;
 	}
 
+	try {
+		std::cout << "Attempting Async Server test..." << "\n";
+
+		rconpp::rcon_server server("0.0.0.0", 27013, "testing");
+
+		server.on_log = [](const std::string_view log) {
+			std::cout << "ASYNC SERVER: " << log << "\n";
+		};
+
+		// Answer from another thread, after on_command_async has already returned.
+		server.on_command_async = [](const rconpp::client_command& command, rconpp::command_responder responder) {
+			std::thread([command, responder]() {
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+				responder.respond(command.command == "test" ? "Deferred Success" : "Bad Command");
+			}).detach();
+		};
+
+		server.start(true);
+
+		rconpp::rcon_client client("127.0.0.1", 27013, "testing");
+
+		client.on_log = [](const std::string_view log) {
+			std::cout << "ASYNC CLIENT: " << log << "\n";
+		};
+
+		client.start(true);
+
+		if (!client.connected) {
+			throw std::logic_error("Failed to make a connection to the server.");
+		}
+
+		rconpp::response res = client.send_data_sync("test", 3, rconpp::data_type::SERVERDATA_EXECCOMMAND);
+
+		if (!res.server_responded || res.data.find("Deferred Success") == std::string::npos) {
+			std::cout << "Bad response received! Response from server was: " << res.data << "\n";
+			throw std::logic_error("No server response or bad response sent by server.");
+		}
+
+		std::cout << "Server responded later with Success, Async Server test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "Async Server test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
+	try {
+		std::cout << "Attempting Multi-packet test..." << "\n";
+
+		rconpp::rcon_server server("0.0.0.0", 27014, "testing");
+
+		server.on_log = [](const std::string_view log) {};
+
+		// Big enough to need several packets.
+		std::string big_response{};
+		for (int i = 0; i < 20000; i++) {
+			big_response += static_cast<char>('a' + i % 26);
+		}
+
+		server.on_command = [&big_response](const rconpp::client_command& command) {
+			return command.command == "dump" ? big_response : std::string("small");
+		};
+
+		server.start(true);
+
+		rconpp::rcon_client client("127.0.0.1", 27014, "testing");
+
+		client.on_log = [](const std::string_view log) {
+			std::cout << "MULTI-PACKET CLIENT: " << log << "\n";
+		};
+
+		client.start(true);
+
+		if (!client.connected) {
+			throw std::logic_error("Failed to make a connection to the server.");
+		}
+
+		rconpp::response res = client.send_data_sync("dump", 3, rconpp::data_type::SERVERDATA_EXECCOMMAND);
+
+		if (!res.server_responded || res.data != big_response) {
+			std::cout << "Bad response received! Response was " << res.data.size() << " bytes, expected " << big_response.size() << "\n";
+			throw std::logic_error("Multi-packet response was not put back together.");
+		}
+
+		res = client.send_data_sync("other", 4, rconpp::data_type::SERVERDATA_EXECCOMMAND);
+
+		if (!res.server_responded || res.data != "small") {
+			throw std::logic_error("Response after a multi-packet response was wrong.");
+		}
+
+		std::cout << "Full response received, Multi-packet test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "Multi-packet test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
+	try {
+		std::cout << "Attempting Command Router test..." << "\n";
+
+		static constexpr rconpp::static_command_table<4> fixed_verbs({ "kick", "ban", "say", "status" });
+		static_assert(fixed_verbs.valid(), "The fixed verbs should have a perfect hash.");
+		static_assert(fixed_verbs.find("say") == 2 && fixed_verbs.find("unknown") == -1, "The perfect hash should be usable at compile time.");
+
+		rconpp::command_args args("  kick \"Some Player\"   griefing  ");
+
+		if (args.count() != 3 || args.next() != "kick" || args.next() != "Some Player" || args.remaining() != "griefing  " || args.next() != "griefing" || !args.empty()) {
+			throw std::logic_error("Arguments were split wrong.");
+		}
+
+		rconpp::command_router router{};
+		router.use_table(fixed_verbs);
+
+		router.add("kick", [](const rconpp::command_view& command, rconpp::command_args kick_args) {
+			return "kicked " + std::string(kick_args.next());
+		});
+
+		// Verbs outside of the fixed set still go through the hash table.
+		for (int i = 0; i < 50; i++) {
+			router.add("verb" + std::to_string(i), [i](const rconpp::command_view& command, rconpp::command_args) {
+				return std::to_string(i);
+			});
+		}
+
+		const rconpp::connected_client client{};
+		std::string routed{};
+
+		if (!router.dispatch(rconpp::command_view("kick bob", client), routed) || routed != "kicked bob") {
+			throw std::logic_error("A verb in the fixed set wasn't routed.");
+		}
+
+		if (!router.dispatch(rconpp::command_view("verb37", client), routed) || routed != "37") {
+			throw std::logic_error("A verb in the hash table wasn't routed.");
+		}
+
+		if (router.dispatch(rconpp::command_view("ban bob", client), routed) || router.unrouted() != 1) {
+			throw std::logic_error("A verb without a handler was routed.");
+		}
+
+		const std::vector<rconpp::command_stats> stats = router.stats();
+
+		if (stats.size() != 51 || stats[0].verb != "kick" || stats[0].calls != 1 || stats[38].calls != 1 || stats[1].calls != 0) {
+			throw std::logic_error("Per-verb counters are wrong.");
+		}
+
+		std::cout << "Verbs routed and counted, Command Router test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "Command Router test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
+	try {
+		std::cout << "Attempting Command View test..." << "\n";
+
+		rconpp::rcon_server server("0.0.0.0", 27022, "testing");
+
+		server.on_log = [](const std::string_view log) {};
+
+		server.on_command_view = [](const rconpp::command_view& command) {
+			if (!command.client.authenticated) {
+				return std::string("not authenticated");
+			}
+
+			// Routing on the view itself, only the command that needs it is copied.
+			if (command.command.substr(0, 5) == "keep ") {
+				return "kept " + command.to_command().command.substr(5);
+			}
+
+			return std::string("echo ").append(command.command);
+		};
+
+		// Routed verbs are taken before on_command_view sees them.
+		server.commands.add("sum", [](const rconpp::command_view& command, rconpp::command_args args) {
+			int total = 0;
+
+			for (std::string_view number = args.next(); !number.empty(); number = args.next()) {
+				total += std::stoi(std::string(number));
+			}
+
+			return std::to_string(total);
+		});
+
+		server.start(true);
+
+		rconpp::rcon_client client("127.0.0.1", 27022, "testing");
+
+		client.on_log = [](const std::string_view log) {};
+
+		client.start(true);
+
+		if (!client.connected) {
+			throw std::logic_error("Failed to make a connection to the server.");
+		}
+
+		const rconpp::response echoed = client.send("hello").get();
+		const rconpp::response kept = client.send("keep this").get();
+		const rconpp::response summed = client.send("sum 1 2 39").get();
+
+		if (echoed.data != "echo hello" || kept.data != "kept this") {
+			throw std::logic_error("Command views didn't match the commands sent (got \"" + echoed.data + "\" and \"" + kept.data + "\").");
+		}
+
+		if (summed.data != "42") {
+			throw std::logic_error("A routed verb got the wrong response (got \"" + summed.data + "\").");
+		}
+
+		std::cout << "Commands answered from views, Command View test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "Command View test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
+	try {
+		std::cout << "Attempting Pipelined Client test..." << "\n";
+
+		rconpp::rcon_server server("0.0.0.0", 27015, "testing");
+
+		server.on_log = [](const std::string_view log) {};
+
+		server.on_command = [](const rconpp::client_command& command) {
+			return "echo " + command.command;
+		};
+
+		server.start(true);
+
+		rconpp::rcon_client client("127.0.0.1", 27015, "testing");
+
+		client.on_log = [](const std::string_view log) {
+			std::cout << "PIPELINED CLIENT: " << log << "\n";
+		};
+
+		client.start(true);
+
+		if (!client.connected) {
+			throw std::logic_error("Failed to make a connection to the server.");
+		}
+
+		// Several threads fire off commands at once, none of them picking IDs, then wait on every response.
+		std::vector<std::thread> senders{};
+		std::atomic<int> matched{0};
+
+		for (int t = 0; t < 4; t++) {
+			senders.emplace_back([&client, &matched, t]() {
+				std::vector<std::pair<std::string, std::future<rconpp::response>>> results{};
+
+				for (int i = 0; i < 50; i++) {
+					std::string command = "cmd-" + std::to_string(t) + "-" + std::to_string(i);
+					std::future<rconpp::response> result = client.send(command);
+					results.emplace_back(std::move(command), std::move(result));
+				}
+
+				for (auto& [command, result] : results) {
+					const rconpp::response res = result.get();
+
+					if (res.server_responded && res.data == "echo " + command) {
+						matched++;
+					}
+				}
+			});
+		}
+
+		for (auto& sender : senders) {
+			sender.join();
+		}
+
+		if (matched != 200) {
+			std::cout << "Only " << matched << " of 200 responses matched their command." << "\n";
+			throw std::logic_error("Responses were lost or mixed up.");
+		}
+
+		std::cout << "Every response matched its command, Pipelined Client test passed!" << "\n";
+
+		const std::vector<rconpp::response> batch = client.send_batch({ "first", "second", "third" }).get();
+
+		if (batch.size() != 3 || batch[0].data != "echo first" || batch[1].data != "echo second" || batch[2].data != "echo third") {
+			throw std::logic_error("Batched responses did not come back in order.");
+		}
+
+		std::cout << "Batched responses came back in order, Batch test passed!" << "\n";
+
+#ifdef RCONPP_CORO
+		std::promise<bool> coroutine_passed{};
+		std::future<bool> coroutine_result = coroutine_passed.get_future();
+
+		run_coroutine_test(client, coroutine_passed);
+
+		if (coroutine_result.wait_for(std::chrono::seconds(rconpp::REQUEST_TIMEOUT)) != std::future_status::ready || !coroutine_result.get()) {
+			throw std::logic_error("Coroutine did not get the right responses.");
+		}
+
+		std::cout << "Coroutine got both responses, Coroutine test passed!" << "\n";
+#endif
+	} catch(std::exception& e) {
+		std::cout << "Pipelined Client test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
+	try {
+		std::cout << "Attempting Client Pool test..." << "\n";
+
+		rconpp::rcon_server server("0.0.0.0", 27016, "testing");
+
+		server.on_log = [](const std::string_view log) {};
+
+		server.on_command = [](const rconpp::client_command& command) {
+			return "echo " + command.command;
+		};
+
+		server.start(true);
+
+		rconpp::rcon_client_pool pool("127.0.0.1", 27016, "testing", 3);
+
+		pool.on_log = [](const std::string_view log) {};
+
+		if (!pool.start() || pool.connected_count() != 3) {
+			throw std::logic_error("Not every client in the pool connected.");
+		}
+
+		std::vector<std::pair<std::string, std::future<rconpp::response>>> results{};
+
+		for (int i = 0; i < 60; i++) {
+			std::string command = "pooled-" + std::to_string(i);
+			std::future<rconpp::response> result = pool.send(command);
+			results.emplace_back(std::move(command), std::move(result));
+		}
+
+		for (auto& [command, result] : results) {
+			const rconpp::response res = result.get();
+
+			if (!res.server_responded || res.data != "echo " + command) {
+				throw std::logic_error("Pooled response did not match its command.");
+			}
+		}
+
+		if (pool.send_data_sync("sync", 5, rconpp::data_type::SERVERDATA_EXECCOMMAND).data != "echo sync") {
+			throw std::logic_error("Pooled send_data_sync did not get the right response.");
+		}
+
+		std::cout << "Every pooled response matched its command, Client Pool test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "Client Pool test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
+	try {
+		std::cout << "Attempting Fleet test..." << "\n";
+
+		rconpp::rcon_server server_a("0.0.0.0", 27017, "testing");
+		rconpp::rcon_server server_b("0.0.0.0", 27018, "other");
+
+		for (rconpp::rcon_server* server : { &server_a, &server_b }) {
+			server->on_log = [](const std::string_view log) {};
+
+			server->on_command = [](const rconpp::client_command& command) {
+				return "echo " + command.command;
+			};
+
+			server->start(true);
+		}
+
+		rconpp::rcon_fleet fleet{};
+		fleet.on_log = [](const std::string_view log) { std::cout << "FLEET: " << log << "\n"; };
+
+		const std::vector<rconpp::rcon_endpoint> endpoints = {
+			{ "127.0.0.1", 27017, "testing" },
+			{ "127.0.0.1", 27018, "other" },
+			{ "127.0.0.1", 27017, "wrong" },
+			{ "127.0.0.1", 27019, "testing" },
+		};
+
+		const std::vector<rconpp::fleet_result> results = fleet.execute(endpoints, "save");
+
+		if (results.size() != endpoints.size()) {
+			throw std::logic_error("Fleet did not give one result per endpoint.");
+		}
+
+		if (results[0].status != rconpp::FLEET_OK || results[0].result.data != "echo save" || results[1].status != rconpp::FLEET_OK || results[1].result.data != "echo save") {
+			throw std::logic_error("Fleet did not get a response from every working server.");
+		}
+
+		if (results[2].status != rconpp::FLEET_AUTH_FAILED || results[3].status != rconpp::FLEET_CONNECT_FAILED) {
+			throw std::logic_error("Fleet did not report failing servers correctly.");
+		}
+
+		std::cout << "Every server gave the expected result, Fleet test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "Fleet test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
+	try {
+		std::cout << "Attempting Shared IO Context test..." << "\n";
+
+		rconpp::rcon_server server("0.0.0.0", 27020, "testing");
+
+		server.on_log = [](const std::string_view log) {};
+
+		server.on_command = [](const rconpp::client_command& command) {
+			return "echo " + command.command;
+		};
+
+		server.start(true);
+
+		// Every client shares the context's one thread, rather than having two threads each.
+		rconpp::rcon_io_context context(1);
+
+		std::vector<std::unique_ptr<rconpp::rcon_client>> clients{};
+
+		for (int c = 0; c < 20; c++) {
+			auto client = std::make_unique<rconpp::rcon_client>("127.0.0.1", 27020, "testing");
+
+			client->on_log = [](const std::string_view log) {};
+
+			client->attach(context);
+			client->start(true);
+
+			if (!client->connected) {
+				throw std::logic_error("Failed to make a connection to the server.");
+			}
+
+			clients.emplace_back(std::move(client));
+		}
+
+		std::vector<std::pair<std::string, std::future<rconpp::response>>> results{};
+
+		for (size_t c = 0; c < clients.size(); c++) {
+			for (int i = 0; i < 10; i++) {
+				std::string command = "shared-" + std::to_string(c) + "-" + std::to_string(i);
+				std::future<rconpp::response> result = clients[c]->send(command);
+				results.emplace_back(std::move(command), std::move(result));
+			}
+		}
+
+		for (auto& [command, result] : results) {
+			const rconpp::response res = result.get();
+
+			if (!res.server_responded || res.data != "echo " + command) {
+				throw std::logic_error("Attached client response did not match its command.");
+			}
+		}
+
+		if (clients[0]->send_data_sync("sync", 5, rconpp::data_type::SERVERDATA_EXECCOMMAND).data != "echo sync") {
+			throw std::logic_error("Attached client send_data_sync did not get the right response.");
+		}
+
+		std::cout << "Every attached client got its responses, Shared IO Context test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "Shared IO Context test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
+	try {
+		std::cout << "Attempting Deadline test..." << "\n";
+
+		// Commands are never answered, so only the deadline can end them. The responders outlive the server.
+		std::mutex held_mutex;
+		std::vector<rconpp::command_responder> held{};
+
+		{
+			rconpp::rcon_server server("0.0.0.0", 27021, "testing");
+
+			server.on_log = [](const std::string_view log) {};
+
+			server.on_command_async = [&held_mutex, &held](const rconpp::client_command& command, rconpp::command_responder responder) {
+				std::lock_guard lock(held_mutex);
+				held.emplace_back(std::move(responder));
+			};
+
+			server.start(true);
+
+			rconpp::rcon_client client("127.0.0.1", 27021, "testing");
+
+			client.on_log = [](const std::string_view log) {};
+
+			client.start(true);
+
+			if (!client.connected) {
+				throw std::logic_error("Failed to make a connection to the server.");
+			}
+
+			const auto started = std::chrono::steady_clock::now();
+
+			const rconpp::response res = client.send("hang", rconpp::data_type::SERVERDATA_EXECCOMMAND, started + std::chrono::milliseconds(200)).get();
+
+			const auto waited = std::chrono::steady_clock::now() - started;
+
+			if (res.server_responded || waited < std::chrono::milliseconds(200) || waited > std::chrono::seconds(1)) {
+				throw std::logic_error("Request did not fail at its deadline.");
+			}
+		}
+
+		// The server is gone, so answering (or dropping) what it left behind does nothing.
+		if (held.empty()) {
+			throw std::logic_error("Server never handed over the command.");
+		}
+
+		held.front().respond("Too late");
+		held.clear();
+
+		std::cout << "Request failed at its deadline, Deadline test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "Deadline test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
+	try {
+		std::cout << "Attempting Metrics test..." << "\n";
+
+		rconpp::latency_histogram histogram{};
+
+		for (int i = 1; i <= 1000; i++) {
+			histogram.record(std::chrono::microseconds(i));
+		}
+
+		const rconpp::histogram_snapshot snapshot = histogram.snapshot();
+		const auto p50 = snapshot.percentile(50);
+		const auto p99 = snapshot.percentile(99);
+
+		// Buckets are within about 3% of the real value.
+		if (snapshot.count != 1000 || p50 < std::chrono::microseconds(485) || p50 > std::chrono::microseconds(516) || p99 < std::chrono::microseconds(960) || p99 > std::chrono::microseconds(1021) || snapshot.max != std::chrono::microseconds(1000)) {
+			throw std::logic_error("Percentiles are wrong (p50 " + std::to_string(p50.count()) + "ns, p99 " + std::to_string(p99.count()) + "ns).");
+		}
+
+		rconpp::rcon_server server("0.0.0.0", 27023, "testing");
+
+		server.on_log = [](const std::string_view log) {};
+
+		server.on_command = [](const rconpp::client_command& command) {
+			return "echo " + command.command;
+		};
+
+		server.commands.add("ping", [](const rconpp::command_view& command, rconpp::command_args args) {
+			return std::string("pong");
+		});
+
+		server.start(true);
+
+		rconpp::rcon_client client("127.0.0.1", 27023, "testing");
+
+		client.on_log = [](const std::string_view log) {};
+
+		client.start(true);
+
+		if (!client.connected) {
+			throw std::logic_error("Failed to make a connection to the server.");
+		}
+
+		client.send("ping").get();
+		client.send("hello").get();
+
+		// The response can beat the sending thread to counting what it sent, so give it a moment.
+		const auto counted_by = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+
+		while (client.metrics().bytes_out != server.metrics().bytes_in && std::chrono::steady_clock::now() < counted_by) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		const rconpp::server_metrics server_stats = server.metrics();
+		const rconpp::client_metrics client_stats = client.metrics();
+
+		if (server_stats.connections_accepted != 1 || server_stats.auth_successes != 1 || server_stats.handler_time.count != 2 || server_stats.request_time.count != 2) {
+			throw std::logic_error("Server counters are wrong.");
+		}
+
+		if (server_stats.verbs.size() != 1 || server_stats.verbs[0].calls != 1) {
+			throw std::logic_error("The routed verb wasn't counted.");
+		}
+
+		// The login and two commands, each command followed by its terminator.
+		if (client_stats.requests_sent != 3 || client_stats.responses_received != 3 || client_stats.packets_out != 5 || server_stats.packets_in != 5) {
+			throw std::logic_error("Client counters are wrong.");
+		}
+
+		if (client_stats.bytes_out != server_stats.bytes_in || client_stats.request_time.count != 3) {
+			throw std::logic_error("Byte counts don't match.");
+		}
+
+		const std::string text = server_stats.to_text();
+
+		if (text.find("rconpp_server_auth_successes_total 1") == std::string::npos || text.find("rconpp_server_verb_handler_seconds_count{verb=\"ping\"} 1") == std::string::npos) {
+			throw std::logic_error("The text format is missing metrics.");
+		}
+
+		if (client_stats.to_text().find("rconpp_client_request_seconds{quantile=\"0.99\"}") == std::string::npos) {
+			throw std::logic_error("The client's text format is missing metrics.");
+		}
+
+		std::cout << "Everything was counted, Metrics test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "Metrics test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
+	try {
+		std::cout << "Attempting Logging test..." << "\n";
+
+		// No log callbacks at all, which used to throw.
+		rconpp::rcon_client offline("127.0.0.1", 27019, "testing");
+
+		if (offline.send_data_sync("test", 1, rconpp::data_type::SERVERDATA_EXECCOMMAND).server_responded) {
+			throw std::logic_error("A client that isn't connected got a response.");
+		}
+
+		// Declared before the server, as it keeps logging until it's destroyed.
+		std::mutex records_mutex;
+		std::vector<rconpp::log_record> records{};
+		std::vector<std::string> commands{};
+		size_t lines = 0;
+
+		rconpp::rcon_server server("0.0.0.0", 27024, "testing");
+
+		server.on_log = [&records_mutex, &lines](const std::string_view log) {
+			std::lock_guard lock(records_mutex);
+			lines++;
+		};
+
+		server.on_log_record = [&records_mutex, &records, &commands](const rconpp::log_record& record) {
+			std::lock_guard lock(records_mutex);
+			records.push_back(record);
+
+			// The text only lives as long as the callback.
+			if (record.event == rconpp::EVENT_COMMAND_RECEIVED) {
+				commands.emplace_back(record.text);
+			}
+		};
+
+		server.on_command = [](const rconpp::client_command& command) {
+			return std::string("ok");
+		};
+
+		server.start(true);
+
+		rconpp::rcon_client wrong_password("127.0.0.1", 27024, "wrong");
+
+		wrong_password.start(true);
+
+		rconpp::rcon_client client("127.0.0.1", 27024, "testing");
+
+		client.start(true);
+
+		if (wrong_password.connected || !client.connected) {
+			throw std::logic_error("Clients didn't connect as expected.");
+		}
+
+		// Commands are only logged at LOG_DEBUG, which is below the default level.
+		client.send("hidden").get();
+		server.min_log_level = rconpp::LOG_DEBUG;
+		client.send("shown").get();
+
+		std::lock_guard lock(records_mutex);
+
+		const auto failed_login = std::find_if(records.begin(), records.end(), [](const rconpp::log_record& record) {
+			return record.event == rconpp::EVENT_AUTH_FAILED;
+		});
+
+		if (failed_login == records.end() || failed_login->level != rconpp::LOG_WARNING || failed_login->peer().rfind("127.0.0.1:", 0) != 0) {
+			throw std::logic_error("The failed login wasn't logged with the client's address.");
+		}
+
+		if (commands.size() != 1 || commands[0] != "shown" || lines != records.size()) {
+			throw std::logic_error("Log levels weren't respected.");
+		}
+
+		std::cout << "Records filtered and typed, Logging test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "Logging test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
+	try {
+		std::cout << "Attempting Log Sink test..." << "\n";
+
+		const rconpp::log_record record = rconpp::log_record(rconpp::LOG_WARNING, rconpp::EVENT_REQUEST_TOO_BIG).with_id(7);
+
+		size_t slow_written = 0;
+
+		// A writer that can't keep up, so most records have to be dropped rather than waited on.
+		rconpp::async_log_sink dropping([&slow_written](const std::vector<rconpp::log_entry>& batch) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			slow_written += batch.size();
+		}, 8, rconpp::LOG_OVERFLOW_DROP);
+
+		size_t blocking_written = 0;
+		bool text_kept = true;
+
+		rconpp::async_log_sink blocking([&blocking_written, &text_kept](const std::vector<rconpp::log_entry>& batch) {
+			for (const rconpp::log_entry& entry : batch) {
+				text_kept = text_kept && entry.record.text == "command " + std::to_string(blocking_written++);
+			}
+		}, 8, rconpp::LOG_OVERFLOW_BLOCK);
+
+		std::vector<std::thread> producers{};
+
+		for (int t = 0; t < 4; t++) {
+			producers.emplace_back([&dropping, &record]() {
+				for (int i = 0; i < 250; i++) {
+					dropping.push(record);
+				}
+			});
+		}
+
+		for (int i = 0; i < 1000; i++) {
+			const std::string command = "command " + std::to_string(i);
+			blocking.push(rconpp::log_record(rconpp::LOG_DEBUG, rconpp::EVENT_COMMAND_RECEIVED).with_text(command));
+		}
+
+		for (std::thread& producer : producers) {
+			producer.join();
+		}
+
+		dropping.flush();
+		blocking.flush();
+
+		const rconpp::log_sink_stats dropped_stats = dropping.stats();
+		const rconpp::log_sink_stats blocked_stats = blocking.stats();
+
+		if (dropped_stats.dropped == 0 || dropped_stats.written + dropped_stats.dropped != 1000 || dropped_stats.written != slow_written) {
+			throw std::logic_error("The dropping sink lost count of its records.");
+		}
+
+		if (blocked_stats.dropped != 0 || blocked_stats.written != 1000 || blocking_written != 1000 || !text_kept) {
+			throw std::logic_error("The blocking sink lost records.");
+		}
+
+		const std::string line = rconpp::async_log_sink::format({ record, std::chrono::system_clock::time_point{} });
+
+		if (line != "1970-01-01T00:00:00.000Z warning request_too_big The request with ID 7 is too big to send. This request will not be sent.") {
+			throw std::logic_error("Records were formatted wrong (got \"" + line + "\").");
+		}
+
+		std::cout << "Records written in " << blocked_stats.batches << " batches, Log Sink test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "Log Sink test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
+	try {
+		std::cout << "Attempting Client Registry test..." << "\n";
+
+		rconpp::client_registry registry{};
+		std::atomic<bool> churning{true};
+		std::atomic<bool> torn{false};
+
+		// Readers list the clients the whole time others come and go. Every list has to be one that could have existed.
+		std::vector<std::thread> readers{};
+
+		for (int r = 0; r < 2; r++) {
+			readers.emplace_back([&registry, &churning, &torn]() {
+				while (churning) {
+					const auto listed = registry.snapshot();
+
+					for (const rconpp::connected_client& client : *listed) {
+						if (client.id != static_cast<uint64_t>(client.socket) + 1) {
+							torn = true;
+						}
+					}
+				}
+			});
+		}
+
+		std::vector<std::thread> writers{};
+
+		for (int w = 0; w < 4; w++) {
+			writers.emplace_back([&registry, w]() {
+				for (int i = 0; i < 2000; i++) {
+					rconpp::connected_client client{};
+					client.socket = static_cast<SOCKET_TYPE>(w * 1000 + i % 100);
+					client.id = static_cast<uint64_t>(client.socket) + 1;
+
+					registry.insert(client);
+
+					// Only the first half of the last lap stays, so the registry ends up with 50 clients per writer.
+					if (i % 100 >= 50 || i < 1900) {
+						registry.erase(client.socket);
+					}
+				}
+			});
+		}
+
+		for (auto& writer : writers) {
+			writer.join();
+		}
+
+		churning = false;
+
+		for (auto& reader : readers) {
+			reader.join();
+		}
+
+		if (torn) {
+			throw std::logic_error("A listing had a client that was half written.");
+		}
+
+		const auto settled = registry.snapshot();
+
+		if (registry.size() != 200 || settled->size() != 200 || registry.snapshot() != settled) {
+			throw std::logic_error("The registry lost clients, or rebuilt a list that hadn't changed.");
+		}
+
+		rconpp::rcon_server server("0.0.0.0", 27025, "testing");
+
+		server.on_command = [](const rconpp::client_command& command) {
+			return std::string("ok");
+		};
+
+		server.start(true);
+
+		rconpp::rcon_client first("127.0.0.1", 27025, "testing");
+		first.start(true);
+
+		rconpp::rcon_client second("127.0.0.1", 27025, "testing");
+		second.start(true);
+
+		// Both have logged in once a command has been answered.
+		first.send("ping").get();
+		second.send("ping").get();
+
+		const auto listed = server.connected_clients.snapshot();
+
+		if (listed->size() != 2 || !(*listed)[0].authenticated || !(*listed)[1].authenticated || (*listed)[0].id == (*listed)[1].id) {
+			throw std::logic_error("The server didn't list both clients as logged in.");
+		}
+
+		server.disconnect_client((*listed)[0].socket);
+
+		for (int i = 0; i < 100 && server.connected_clients.size() != 1; i++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		// The old list doesn't change, but a new one does.
+		if (listed->size() != 2 || server.connected_clients.size() != 1 || server.connected_clients.snapshot()->size() != 1) {
+			throw std::logic_error("The disconnected client wasn't removed.");
+		}
+
+		std::cout << "Clients listed under churn, Client Registry test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "Client Registry test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
+	try {
+		std::cout << "Attempting Broadcast test..." << "\n";
+
+		// Declared before the clients, as they keep receiving until they're destroyed.
+		std::mutex received_mutex;
+		std::condition_variable received_condition;
+		std::vector<std::string> first_received{};
+		std::vector<std::string> second_received{};
+
+		rconpp::rcon_server server("0.0.0.0", 27026, "testing");
+
+		server.on_command = [](const rconpp::client_command& command) {
+			return std::string("ok");
+		};
+
+		server.start(true);
+
+		rconpp::rcon_client first("127.0.0.1", 27026, "testing");
+		rconpp::rcon_client second("127.0.0.1", 27026, "testing");
+
+		first.on_broadcast = [&received_mutex, &received_condition, &first_received](const std::string_view message) {
+			std::lock_guard lock(received_mutex);
+			first_received.emplace_back(message);
+			received_condition.notify_all();
+		};
+
+		second.on_broadcast = [&received_mutex, &received_condition, &second_received](const std::string_view message) {
+			std::lock_guard lock(received_mutex);
+			second_received.emplace_back(message);
+			received_condition.notify_all();
+		};
+
+		first.start(true);
+		second.start(true);
+
+		// Both have logged in once a command has been answered.
+		first.send("ping").get();
+		second.send("ping").get();
+
+		const uint16_t first_port = [&server]() {
+			const auto listed = server.connected_clients.snapshot();
+			uint16_t lowest = UINT16_MAX;
+
+			for (const rconpp::connected_client& client : *listed) {
+				lowest = std::min(lowest, ntohs(client.sock_info.sin_port));
+			}
+
+			return lowest;
+		}();
+
+		const std::string long_message(10000, 'x');
+
+		if (server.broadcast("Player joined") != 2) {
+			throw std::logic_error("The broadcast didn't go to both clients.");
+		}
+
+		if (server.broadcast(long_message) != 2) {
+			throw std::logic_error("The long broadcast didn't go to both clients.");
+		}
+
+		// Only goes to whichever client connected on the lowest port.
+		const size_t filtered = server.broadcast("Just you", [first_port](const rconpp::connected_client& client) {
+			return ntohs(client.sock_info.sin_port) == first_port;
+		});
+
+		if (filtered != 1) {
+			throw std::logic_error("The filter wasn't used.");
+		}
+
+		std::unique_lock lock(received_mutex);
+
+		// "Player joined", the long message in three parts, and "Just you" for one of them.
+		const bool arrived = received_condition.wait_for(lock, std::chrono::seconds(5), [&first_received, &second_received]() {
+			return first_received.size() + second_received.size() == 9;
+		});
+
+		if (!arrived) {
+			throw std::logic_error("Not every broadcast arrived.");
+		}
+
+		for (const auto* received : { &first_received, &second_received }) {
+			std::string joined{};
+
+			for (size_t i = 1; i < 4; i++) {
+				joined += (*received)[i];
+			}
+
+			if ((*received)[0] != "Player joined" || joined != long_message) {
+				throw std::logic_error("A broadcast arrived wrong.");
+			}
+		}
+
+		lock.unlock();
+
+		// With no room for anything waiting, every client is left behind.
+		server.max_pending_bytes = 0;
+		server.broadcast("Dropped");
+
+		for (int i = 0; i < 100 && server.metrics().broadcasts_dropped != 2; i++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		const rconpp::server_metrics counted = server.metrics();
+
+		if (counted.broadcasts_sent != 5 || counted.broadcasts_dropped != 2) {
+			throw std::logic_error("Broadcasts weren't counted.");
+		}
+
+		// Commands are still answered for a client broadcasts are skipping.
+		if (first.send("ping").get().data != "ok") {
+			throw std::logic_error("A client stopped getting responses.");
+		}
+
+		// Nothing was routed, as no verbs were added.
+		if (server.commands.unrouted() != 0) {
+			throw std::logic_error("Commands were counted as unrouted without any verbs.");
+		}
+
+		// A request can't use the broadcast ID, or its response would be taken for a broadcast.
+		if (first.send_data_sync("ping", rconpp::BROADCAST_PACKET_ID, rconpp::data_type::SERVERDATA_EXECCOMMAND).server_responded) {
+			throw std::logic_error("A request was sent with the broadcast ID.");
+		}
+
+		std::cout << "Broadcasts encoded once and shared, Broadcast test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "Broadcast test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
+	try {
+		std::cout << "Attempting Timer Wheel test..." << "\n";
+
+		struct mark {
+			std::vector<int>* fired{nullptr};
+			int id{0};
+		};
+
+		const auto start = rconpp::timer_wheel::clock::now();
+		rconpp::timer_wheel wheel(std::chrono::milliseconds(10), start);
+
+		std::vector<int> fired{};
+		std::vector<mark> marks{};
+
+		for (int i = 0; i < 6; i++) {
+			marks.push_back({ &fired, i });
+		}
+
+		const auto record = [](void* context) {
+			const mark& fired_mark = *static_cast<mark*>(context);
+			fired_mark.fired->push_back(fired_mark.id);
+		};
+
+		// One timer on each level, one that gets cancelled, and one that gets moved.
+		rconpp::timer_wheel::timer soon(record, &marks[0]);
+		rconpp::timer_wheel::timer level_one(record, &marks[1]);
+		rconpp::timer_wheel::timer level_two(record, &marks[2]);
+		rconpp::timer_wheel::timer level_three(record, &marks[3]);
+		rconpp::timer_wheel::timer cancelled(record, &marks[4]);
+		rconpp::timer_wheel::timer moved(record, &marks[5]);
+
+		wheel.schedule(level_three, start + std::chrono::hours(3));
+		wheel.schedule(level_two, start + std::chrono::seconds(50));
+		wheel.schedule(level_one, start + std::chrono::milliseconds(700));
+		wheel.schedule(soon, start + std::chrono::milliseconds(5));
+		wheel.schedule(cancelled, start + std::chrono::milliseconds(30));
+		wheel.schedule(moved, start + std::chrono::milliseconds(40));
+
+		wheel.cancel(cancelled);
+		wheel.schedule(moved, start + std::chrono::seconds(10));
+
+		if (wheel.size() != 5 || wheel.next_expiry() > start + std::chrono::milliseconds(10)) {
+			throw std::logic_error("Timers weren't scheduled.");
+		}
+
+		const std::vector<std::pair<std::chrono::milliseconds, std::vector<int>>> steps = {
+			{ std::chrono::milliseconds(20), { 0 } },
+			{ std::chrono::milliseconds(690), { 0 } },
+			{ std::chrono::milliseconds(710), { 0, 1 } },
+			{ std::chrono::seconds(49), { 0, 1, 5 } },
+			{ std::chrono::seconds(51), { 0, 1, 5, 2 } },
+			{ std::chrono::hours(3) - std::chrono::seconds(1), { 0, 1, 5, 2 } },
+			{ std::chrono::hours(3) + std::chrono::seconds(1), { 0, 1, 5, 2, 3 } },
+		};
+
+		for (const auto& [elapsed, expected] : steps) {
+			// The wheel never says to wake later than a timer is due.
+			if (wheel.next_expiry() > start + elapsed && expected != fired) {
+				throw std::logic_error("The wheel would have slept through a timer.");
+			}
+
+			wheel.advance(start + elapsed);
+
+			if (fired != expected) {
+				throw std::logic_error("Timers fired at the wrong time, or in the wrong order.");
+			}
+		}
+
+		if (!wheel.empty() || wheel.next_expiry() != rconpp::timer_wheel::clock::time_point::max()) {
+			throw std::logic_error("Fired timers were left on the wheel.");
+		}
+
+		// A timer can put itself back on the wheel, or destroy itself, when it fires.
+		struct repeating {
+			rconpp::timer_wheel* wheel{nullptr};
+			rconpp::timer_wheel::timer timer{};
+			int runs{0};
+		} repeater{ &wheel };
+
+		repeater.timer.context = &repeater;
+		repeater.timer.callback = [](void* context) {
+			auto& self = *static_cast<repeating*>(context);
+
+			if (++self.runs < 3) {
+				self.wheel->schedule(self.timer, rconpp::timer_wheel::clock::now());
+			}
+		};
+
+		std::unique_ptr<rconpp::timer_wheel::timer> one_shot = std::make_unique<rconpp::timer_wheel::timer>();
+		one_shot->context = &one_shot;
+		one_shot->callback = [](void* context) {
+			static_cast<std::unique_ptr<rconpp::timer_wheel::timer>*>(context)->reset();
+		};
+
+		auto now = start + std::chrono::hours(4);
+		wheel.schedule(repeater.timer, now);
+		wheel.schedule(*one_shot, now);
+
+		for (int i = 0; i < 5; i++) {
+			now += std::chrono::milliseconds(10);
+			wheel.advance(now);
+		}
+
+		if (repeater.runs != 3 || one_shot || !wheel.empty()) {
+			throw std::logic_error("Timers weren't rescheduled or destroyed from their callbacks.");
+		}
+
+		std::cout << "Timers fired in order on every level, Timer Wheel test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "Timer Wheel test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
+	try {
+		std::cout << "Attempting Server Timeouts test..." << "\n";
+
+		rconpp::rcon_server server("0.0.0.0", 27027, "testing");
+
+		server.heartbeat_interval = std::chrono::milliseconds(100);
+		server.auth_timeout = std::chrono::milliseconds(300);
+		server.idle_timeout = std::chrono::milliseconds(1000);
+
+		server.on_command = [](const rconpp::client_command& command) {
+			return std::string("ok");
+		};
+
+		server.start(true);
+
+		// Connects, but never logs in.
+		const SOCKET_TYPE silent = socket(AF_INET, SOCK_STREAM, 0);
+
+		sockaddr_in target{};
+		target.sin_family = AF_INET;
+		target.sin_port = htons(27027);
+		inet_pton(AF_INET, "127.0.0.1", &target.sin_addr);
+
+		if (connect(silent, reinterpret_cast<const sockaddr*>(&target), sizeof(target)) != 0) {
+			rconpp::close_socket(silent);
+			throw std::logic_error("The silent client couldn't connect.");
+		}
+
+		rconpp::rcon_client client("127.0.0.1", 27027, "testing");
+		client.start(true);
+
+		if (client.send("ping").get().data != "ok") {
+			rconpp::close_socket(silent);
+			throw std::logic_error("The client didn't log in.");
+		}
+
+		// The silent client misses its login deadline, then the logged in one goes quiet for long enough to be dropped too.
+		for (int i = 0; i < 300 && (server.metrics().auth_timeouts != 1 || server.metrics().idle_timeouts != 1); i++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		rconpp::close_socket(silent);
+
+		const rconpp::server_metrics counted = server.metrics();
+
+		if (counted.auth_timeouts != 1 || counted.idle_timeouts != 1) {
+			throw std::logic_error("Clients weren't timed out.");
+		}
+
+		// Heartbeats go out every 100ms or so until the idle deadline.
+		if (counted.heartbeats_sent < 5 || server.connected_clients.size() != 0) {
+			throw std::logic_error("Heartbeats weren't sent on time (" + std::to_string(counted.heartbeats_sent) + " sent).");
+		}
+
+		std::cout << "Sent " << counted.heartbeats_sent << " heartbeats, Server Timeouts test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "Server Timeouts test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
+	try {
+		std::cout << "Attempting Handler Pool test..." << "\n";
+
+		rconpp::rcon_server server("0.0.0.0", 27028, "testing");
+
+		server.on_log = [](const std::string_view log) {};
+
+		server.handler_threads = 2;
+
+		server.on_command = [](const rconpp::client_command& command) {
+			if (command.command == "slow") {
+				std::this_thread::sleep_for(std::chrono::milliseconds(500));
+				return std::string("slow done");
+			}
+
+			return std::string("fast");
+		};
+
+		server.start(true);
+
+		rconpp::rcon_client busy("127.0.0.1", 27028, "testing");
+		rconpp::rcon_client other("127.0.0.1", 27028, "testing");
+
+		busy.start(true);
+		other.start(true);
+
+		if (!busy.connected || !other.connected) {
+			throw std::logic_error("Failed to make a connection to the server.");
+		}
+
+		std::future<rconpp::response> slow = busy.send("slow");
+
+		// Give the slow command time to reach a worker, so the other client's command has to get past it.
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+		const auto started = std::chrono::steady_clock::now();
+		const rconpp::response fast = other.send("fast").get();
+
+		if (fast.data != "fast" || std::chrono::steady_clock::now() - started > std::chrono::milliseconds(300)) {
+			throw std::logic_error("A command waited on another client's slow command.");
+		}
+
+		if (slow.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+			throw std::logic_error("The slow command wasn't run by a worker.");
+		}
+
+		if (slow.get().data != "slow done") {
+			throw std::logic_error("The slow command's response didn't make it back from the worker.");
+		}
+
+		std::cout << "Commands ran on the workers, Handler Pool test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "Handler Pool test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
+	try {
+		std::cout << "Attempting Handler Queue test..." << "\n";
+
+		std::mutex gate_mutex;
+		std::condition_variable gate_condition;
+		bool gate_open = false;
+		std::atomic<bool> blocked{false};
+
+		rconpp::rcon_server server("0.0.0.0", 27029, "testing");
+
+		server.on_log = [](const std::string_view log) {};
+
+		server.handler_threads = 1;
+		server.handler_queue_size = 1;
+
+		// The only worker is held up until the gate opens (or a few seconds pass, so a failed test doesn't hang).
+		server.on_command = [&gate_mutex, &gate_condition, &gate_open, &blocked](const rconpp::client_command& command) {
+			if (command.command == "block") {
+				blocked = true;
+
+				std::unique_lock lock(gate_mutex);
+				gate_condition.wait_for(lock, std::chrono::seconds(5), [&gate_open]() { return gate_open; });
+			}
+
+			return command.command;
+		};
+
+		server.start(true);
+
+		// Each command comes from its own client, so no response waits on another client's.
+		rconpp::rcon_client first("127.0.0.1", 27029, "testing");
+		rconpp::rcon_client second("127.0.0.1", 27029, "testing");
+		rconpp::rcon_client third("127.0.0.1", 27029, "testing");
+
+		first.start(true);
+		second.start(true);
+		third.start(true);
+
+		if (!first.connected || !second.connected || !third.connected) {
+			throw std::logic_error("Failed to make a connection to the server.");
+		}
+
+		const auto open_gate = [&gate_mutex, &gate_condition, &gate_open]() {
+			std::lock_guard lock(gate_mutex);
+			gate_open = true;
+			gate_condition.notify_all();
+		};
+
+		std::future<rconpp::response> blocking = first.send("block");
+
+		for (int i = 0; i < 200 && !blocked; i++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		// The worker is busy, so this one takes the only place in the queue.
+		std::future<rconpp::response> queued = second.send("queued");
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+		// With nowhere left to put it, this one is answered straight away with a blank response.
+		const rconpp::response refused = third.send("refused").get();
+		const bool refused_early = blocking.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+
+		open_gate();
+
+		if (!blocked || !refused.server_responded || !refused.data.empty() || !refused_early) {
+			throw std::logic_error("A command past the end of the queue wasn't given a blank response.");
+		}
+
+		if (blocking.get().data != "block" || queued.get().data != "queued") {
+			throw std::logic_error("The queued commands weren't answered once the worker was free.");
+		}
+
+		std::cout << "The full queue refused a command, Handler Queue test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "Handler Queue test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
+	try {
+		std::cout << "Attempting IO Threads test..." << "\n";
+
+		constexpr size_t client_count = 8;
+
+		std::atomic<size_t> broadcasts_received{0};
+
+		rconpp::rcon_server server("0.0.0.0", 27030, "testing");
+
+		server.on_log = [](const std::string_view log) {};
+
+		// Clients are handed to the loops in turn, so each loop ends up with two.
+		server.io_threads = 4;
+
+		server.on_command = [](const rconpp::client_command& command) {
+			return "echo " + command.command;
+		};
+
+		server.start(true);
+
+		std::vector<std::unique_ptr<rconpp::rcon_client>> clients{};
+
+		for (size_t i = 0; i < client_count; i++) {
+			auto client = std::make_unique<rconpp::rcon_client>("127.0.0.1", 27030, "testing");
+
+			client->on_log = [](const std::string_view log) {};
+			client->on_broadcast = [&broadcasts_received](const std::string_view message) {
+				if (message == "Hello everyone") {
+					broadcasts_received++;
+				}
+			};
+
+			client->start(true);
+
+			if (!client->connected) {
+				throw std::logic_error("Failed to make a connection to the server.");
+			}
+
+			clients.emplace_back(std::move(client));
+		}
+
+		std::vector<std::future<rconpp::response>> responses{};
+
+		for (size_t i = 0; i < client_count; i++) {
+			responses.emplace_back(clients[i]->send("client " + std::to_string(i)));
+		}
+
+		for (size_t i = 0; i < client_count; i++) {
+			if (responses[i].get().data != "echo client " + std::to_string(i)) {
+				throw std::logic_error("A client on one of the loops wasn't answered properly.");
+			}
+		}
+
+		if (server.broadcast("Hello everyone") != client_count) {
+			throw std::logic_error("The broadcast wasn't sent to every client.");
+		}
+
+		for (int i = 0; i < 200 && broadcasts_received != client_count; i++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		if (broadcasts_received != client_count) {
+			throw std::logic_error("The broadcast only reached " + std::to_string(broadcasts_received) + " clients.");
+		}
+
+		// Each socket is closed by the loop that owns it, whichever thread asks.
+		const auto listed = server.connected_clients.snapshot();
+
+		for (const rconpp::connected_client& client : *listed) {
+			server.disconnect_client(client.socket);
+		}
+
+		const auto all_disconnected = [&clients]() {
+			return std::none_of(clients.begin(), clients.end(), [](const std::unique_ptr<rconpp::rcon_client>& client) {
+				return client->connected.load();
+			});
+		};
+
+		for (int i = 0; i < 200 && (!server.connected_clients.empty() || !all_disconnected()); i++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		if (listed->size() != client_count || !server.connected_clients.empty() || !all_disconnected()) {
+			throw std::logic_error("Not every client was disconnected.");
+		}
+
+		std::cout << "Every loop answered, broadcast, and disconnected its clients, IO Threads test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "IO Threads test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
+	try {
+		std::cout << "Attempting Packet Size Limit test..." << "\n";
+
+		rconpp::rcon_server server("0.0.0.0", 27031, "testing");
+
+		server.on_log = [](const std::string_view log) {};
+
+		std::string long_response{};
+		for (int i = 0; i < 450; i++) {
+			long_response += static_cast<char>('a' + i % 26);
+		}
+
+		server.on_command = [&long_response](const rconpp::client_command& command) {
+			return long_response;
+		};
+
+		server.start(true);
+
+		rconpp::rcon_client client("127.0.0.1", 27031, "testing");
+
+		client.on_log = [](const std::string_view log) {};
+
+		client.start(true);
+
+		if (!client.connected) {
+			throw std::logic_error("Failed to make a connection to the server.");
+		}
+
+		// Each response is followed by the terminator the client sent after its command.
+		const auto packets_for = [&client]() {
+			const uint64_t before = client.metrics().packets_in;
+			const rconpp::response res = client.send("dump").get();
+			return std::make_pair(res, client.metrics().packets_in - before - 1);
+		};
+
+		const auto [whole, whole_packets] = packets_for();
+
+		if (whole.data != long_response || whole_packets != 1) {
+			throw std::logic_error("The response should fit in one packet at the default size.");
+		}
+
+		// Bodies of 100 bytes from now on, so the same response needs 5 packets.
+		server.max_packet_size = 100 + rconpp::MIN_PACKET_SIZE;
+
+		const auto [split, split_packets] = packets_for();
+
+		if (split_packets != 5) {
+			throw std::logic_error("The response was split over " + std::to_string(split_packets) + " packets, not 5.");
+		}
+
+		if (split.data != long_response) {
+			throw std::logic_error("The split response wasn't put back together.");
+		}
+
+		std::cout << "Response split at the new size, Packet Size Limit test passed!" << "\n";
+	} catch(std::exception& e) {
+		std::cout << "Packet Size Limit test failed. Reason: " << e.what() << "\n";
+		return -1;
+	}
+
 	if (std::getenv("RCON_TESTING_IP") && std::getenv("RCON_TESTING_PORT") &&
 			std::getenv("RCON_TESTING_PASSWORD")) {
 		try {